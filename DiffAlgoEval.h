@@ -13,6 +13,7 @@
 #include <QtGui/QAction>
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QCheckBox>
+#include <QtWidgets/QComboBox>
 #include <QtWidgets/QFrame>
 #include <QtWidgets/QLabel>
 #include <QtWidgets/QLineEdit>
@@ -21,6 +22,7 @@
 #include <QtWidgets/QMenuBar>
 #include <QtWidgets/QPushButton>
 #include <QtWidgets/QStatusBar>
+#include <QtWidgets/QTableView>
 #include <QtWidgets/QWidget>
 
 QT_BEGIN_NAMESPACE
@@ -48,6 +50,15 @@ public:
     QLineEdit *lineEdit_newfile;
     QFrame *frame_3;
     QPushButton *pushButton_starteval;
+    QPushButton *pushButton_loadresults;
+    QPushButton *pushButton_clearresults;
+    QComboBox *comboBox_algofilter;
+    QLineEdit *lineEdit_hashfilter;
+    QComboBox *comboBox_metric;
+    QLineEdit *lineEdit_metricmin;
+    QLineEdit *lineEdit_metricmax;
+    QTableView *tableView_results;
+    QWidget *widget_chart;
     QMenuBar *menubar;
     QMenu *menuHelp;
     QMenu *menuHistory;
@@ -127,7 +138,38 @@ public:
         frame_3->setFrameShadow(QFrame::Shadow::Raised);
         pushButton_starteval = new QPushButton(frame_3);
         pushButton_starteval->setObjectName("pushButton_starteval");
-        pushButton_starteval->setGeometry(QRect(30, 140, 75, 24));
+        pushButton_starteval->setGeometry(QRect(20, 40, 91, 24));
+        pushButton_loadresults = new QPushButton(frame_3);
+        pushButton_loadresults->setObjectName("pushButton_loadresults");
+        pushButton_loadresults->setGeometry(QRect(20, 80, 91, 24));
+        pushButton_clearresults = new QPushButton(frame_3);
+        pushButton_clearresults->setObjectName("pushButton_clearresults");
+        pushButton_clearresults->setGeometry(QRect(20, 120, 91, 24));
+        comboBox_algofilter = new QComboBox(frame_3);
+        comboBox_algofilter->setObjectName("comboBox_algofilter");
+        comboBox_algofilter->setGeometry(QRect(130, 10, 101, 22));
+        lineEdit_hashfilter = new QLineEdit(frame_3);
+        lineEdit_hashfilter->setObjectName("lineEdit_hashfilter");
+        lineEdit_hashfilter->setGeometry(QRect(240, 10, 151, 22));
+        comboBox_metric = new QComboBox(frame_3);
+        comboBox_metric->addItem(QString());
+        comboBox_metric->addItem(QString());
+        comboBox_metric->addItem(QString());
+        comboBox_metric->addItem(QString());
+        comboBox_metric->setObjectName("comboBox_metric");
+        comboBox_metric->setGeometry(QRect(400, 10, 91, 22));
+        lineEdit_metricmin = new QLineEdit(frame_3);
+        lineEdit_metricmin->setObjectName("lineEdit_metricmin");
+        lineEdit_metricmin->setGeometry(QRect(500, 10, 61, 22));
+        lineEdit_metricmax = new QLineEdit(frame_3);
+        lineEdit_metricmax->setObjectName("lineEdit_metricmax");
+        lineEdit_metricmax->setGeometry(QRect(570, 10, 61, 22));
+        tableView_results = new QTableView(frame_3);
+        tableView_results->setObjectName("tableView_results");
+        tableView_results->setGeometry(QRect(130, 40, 501, 261));
+        widget_chart = new QWidget(frame_3);
+        widget_chart->setObjectName("widget_chart");
+        widget_chart->setGeometry(QRect(640, 10, 141, 291));
         MainWindow->setCentralWidget(centralwidget);
         menubar = new QMenuBar(MainWindow);
         menubar->setObjectName("menubar");
@@ -166,6 +208,16 @@ public:
         pushButton_oldfile->setText(QCoreApplication::translate("MainWindow", "SelectOldFile", nullptr));
         pushButton_newfile->setText(QCoreApplication::translate("MainWindow", "SelectNewFile", nullptr));
         pushButton_starteval->setText(QCoreApplication::translate("MainWindow", "StartEval", nullptr));
+        pushButton_loadresults->setText(QCoreApplication::translate("MainWindow", "LoadResults", nullptr));
+        pushButton_clearresults->setText(QCoreApplication::translate("MainWindow", "ClearResults", nullptr));
+        lineEdit_hashfilter->setPlaceholderText(QCoreApplication::translate("MainWindow", "MD5 contains", nullptr));
+        comboBox_metric->setItemText(0, QCoreApplication::translate("MainWindow", "Duration", nullptr));
+        comboBox_metric->setItemText(1, QCoreApplication::translate("MainWindow", "Memory", nullptr));
+        comboBox_metric->setItemText(2, QCoreApplication::translate("MainWindow", "CPU", nullptr));
+        comboBox_metric->setItemText(3, QCoreApplication::translate("MainWindow", "PatchSize", nullptr));
+
+        lineEdit_metricmin->setPlaceholderText(QCoreApplication::translate("MainWindow", "min", nullptr));
+        lineEdit_metricmax->setPlaceholderText(QCoreApplication::translate("MainWindow", "max", nullptr));
         menuHelp->setTitle(QCoreApplication::translate("MainWindow", "Help", nullptr));
         menuHistory->setTitle(QCoreApplication::translate("MainWindow", "History", nullptr));
     } // retranslateUi
@@ -1,10 +1,30 @@
 #include "mock_algo.h"
+#include "target_sim.h"
 #include <QThread>
+#include <QFile>
+#include <QIODevice>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
 
 int MockAlgo::SetAlgoEvalFilePath(const std::string& old_file_path, const std::string& new_file_path)
 {
     this->old_file_path = old_file_path;
     this->new_file_path = new_file_path;
+    this->eval_io_mode = AlgoEvalIoMode::File;
+    return 0; // Success
+}
+
+int MockAlgo::SetAlgoEvalBuffer(const AlgoEvalBuffer& old_buffer, const AlgoEvalBuffer& new_buffer, AlgoPatchSink patch_sink)
+{
+    if(!patch_sink)
+    {
+        return -1; // Nowhere to write the patch
+    }
+    this->old_buffer = old_buffer;
+    this->new_buffer = new_buffer;
+    this->patch_sink = std::move(patch_sink);
+    this->eval_io_mode = AlgoEvalIoMode::Memory;
     return 0; // Success
 }
 
@@ -17,12 +37,44 @@ int MockAlgo::GetAlgoEvalFilePath(std::string& old_file_path, std::string& new_f
 
 int MockAlgo::StartEval()
 {
-    this->algo_eval_result.SetEvalFiles(this->old_file_path, this->new_file_path); // Set the evaluation files
+    if(this->eval_io_mode == AlgoEvalIoMode::Memory)
+    {
+        this->algo_eval_result.SetEvalBuffers(this->old_buffer, this->new_buffer); // Hash the buffers before timing starts
+    }
+    else
+    {
+        this->algo_eval_result.SetEvalFiles(this->old_file_path, this->new_file_path); // Set the evaluation files
+    }
     this->algo_eval_result.SetEvalStartTime(); // Set the evaluation start time
 
+    // The mock patch does not depend on the index, building it only exercises the cache,
+    // so without the cache the default measurement stays the plain mock evaluation
+    std::shared_ptr<const OldIndex> old_index;
+    if(OldIndexCache::Instance().IsEnabled() && acquireOldIndex(old_index) != 0)
+    {
+        return -1; // Failed to build the old file index
+    }
+
 #if 1
-    QThread::sleep(3); // Simulate the evaluation process with a sleep
-    this->algo_eval_result.SetEvalOccupyMemory(1024); // Set the memory usage (example value)
+    // Simulate the evaluation process with a sleep, in slices so a cancel is noticed
+    constexpr uint64_t mock_memory = 1024;
+    reportProgress(0, mock_memory);
+    for(int slice = 0; slice < 30; slice++)
+    {
+        if(IsCancelRequested())
+        {
+            return -1; // Cancelled
+        }
+        QThread::msleep(100);
+    }
+    uint64_t patch_size = 0;
+    int ret = (this->eval_io_mode == AlgoEvalIoMode::Memory) ? emitMockPatch(patch_size) : writeMockPatch(patch_size);
+    if(ret != 0)
+    {
+        return -1; // Failed to write the patch
+    }
+    this->algo_eval_result.SetEvalPatchSize(patch_size); // Set the generated patch size
+    this->algo_eval_result.SetEvalOccupyMemory(mock_memory); // Set the memory usage (example value)
     this->algo_eval_result.SetEvalOccupyCPU(50); // Set the CPU usage (example value)
     this->algo_eval_result.SetEvalFinished(); // Set the evaluation finished flag
 #endif
@@ -30,9 +82,175 @@ int MockAlgo::StartEval()
     return 0; // Success
 }
 
+int MockAlgo::ApplyPatchConstrained(ConstrainedApplyEnv& env)
+{
+    // The mock patch is the new image itself, so apply streams it through a work buffer
+    constexpr size_t work_buffer_size = 64 * 1024;
+    auto* buffer = static_cast<uint8_t*>(env.heap.Allocate(work_buffer_size));
+    if(buffer == nullptr)
+    {
+        return -1; // Not enough heap on the device
+    }
+
+    int ret = 0;
+    uint64_t offset = 0;
+    while(offset < env.patch_reader.GetSize())
+    {
+        int64_t got = env.patch_reader.Read(offset, buffer, work_buffer_size);
+        if(got <= 0 || env.new_writer.Write(buffer, static_cast<size_t>(got)) != 0)
+        {
+            ret = -1; // Read or write failed
+            break;
+        }
+        offset += static_cast<uint64_t>(got);
+    }
+    env.heap.Free(buffer);
+    return ret;
+}
+
+int MockAlgo::BuildOldIndex(std::vector<uint8_t>& index)
+{
+    // Block hash index: FNV-1a hash and offset of every 64 byte block, sorted by hash.
+    // The old input is scanned front to back in chunks, each chunk read is traced.
+    struct BlockEntry
+    {
+        uint32_t hash;
+        uint32_t reserved;
+        uint64_t offset;
+    };
+    constexpr size_t block_size = 64;
+    constexpr size_t chunk_size = 1024 * 1024; // Multiple of block_size, so blocks never straddle chunks
+    QFile old_file(QString::fromStdString(this->old_file_path));
+    std::vector<uint8_t> chunk;
+    bool from_file = this->eval_io_mode == AlgoEvalIoMode::File;
+    if(from_file)
+    {
+        if(!old_file.open(QIODevice::ReadOnly))
+        {
+            return -1; // Failed to open the old file
+        }
+        chunk.resize(chunk_size);
+    }
+    std::vector<BlockEntry> entries;
+    uint64_t chunk_offset = 0;
+    for(;;)
+    {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        if(from_file)
+        {
+            int64_t got = readOldFile(old_file, chunk_offset, chunk.data(), chunk_size);
+            if(got < 0)
+            {
+                return -1; // Failed to read the old file
+            }
+            data = chunk.data();
+            size = static_cast<size_t>(got);
+        }
+        else if(chunk_offset < this->old_buffer.size)
+        {
+            data = this->old_buffer.data + chunk_offset;
+            size = std::min(chunk_size, static_cast<size_t>(this->old_buffer.size - chunk_offset));
+            traceOldRead(chunk_offset, size);
+        }
+        if(size == 0)
+        {
+            break; // End of the old input
+        }
+        for(size_t offset = 0; offset + block_size <= size; offset += block_size)
+        {
+            uint32_t hash = 2166136261u;
+            for(size_t i = 0; i < block_size; i++)
+            {
+                hash = (hash ^ data[offset + i]) * 16777619u;
+            }
+            entries.push_back(BlockEntry{hash, 0, chunk_offset + offset});
+        }
+        chunk_offset += size;
+        if(size < chunk_size)
+        {
+            break; // Short chunk, the input ended
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [](const BlockEntry& a, const BlockEntry& b) {
+        return a.hash != b.hash ? a.hash < b.hash : a.offset < b.offset;
+    });
+
+    index.resize(entries.size() * sizeof(BlockEntry));
+    if(!entries.empty())
+    {
+        std::memcpy(index.data(), entries.data(), index.size());
+    }
+    return 0; // Success
+}
+
 int MockAlgo::GetEvalResult(AlgoEvalResult &result)
 {
 
     result = this->algo_eval_result; // Copy the result
     return 0; // Success
-}
\ No newline at end of file
+}
+
+int MockAlgo::writeMockPatch(uint64_t& patch_size)
+{
+    // The mock "patch" is simply a copy of the new file
+    if(this->patch_file_path.empty())
+    {
+        std::error_code ec;
+        auto tmp_dir = std::filesystem::temp_directory_path(ec);
+        if(ec)
+        {
+            return -1; // No temporary directory available
+        }
+        this->patch_file_path = (tmp_dir / (std::filesystem::path(this->new_file_path).filename().string() + ".mock.patch")).string();
+    }
+
+    QFile new_file(QString::fromStdString(this->new_file_path));
+    QFile patch_file(QString::fromStdString(this->patch_file_path));
+    if(!new_file.open(QIODevice::ReadOnly) || !patch_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return -1; // Failed to open the files
+    }
+
+    char buffer[1024]; // copy 1KB at a time
+    qint64 bytesRead;
+    uint64_t written = 0;
+    while((bytesRead = new_file.read(buffer, sizeof(buffer))) > 0)
+    {
+        if(IsCancelRequested())
+        {
+            return -1; // Cancelled
+        }
+        if(patch_file.write(buffer, bytesRead) != bytesRead)
+        {
+            return -1; // Failed to write the patch
+        }
+        written += static_cast<uint64_t>(bytesRead);
+        reportProgress(written, progress_memory_bytes);
+    }
+    patch_size = static_cast<uint64_t>(patch_file.size());
+    return 0; // Success
+}
+
+int MockAlgo::emitMockPatch(uint64_t& patch_size)
+{
+    // Same mock "patch" as writeMockPatch, handed to the sink in 1KB chunks
+    constexpr size_t chunk_size = 1024;
+    size_t offset = 0;
+    while(offset < this->new_buffer.size)
+    {
+        size_t size = std::min(chunk_size, this->new_buffer.size - offset);
+        if(IsCancelRequested())
+        {
+            return -1; // Cancelled
+        }
+        if(this->patch_sink(this->new_buffer.data + offset, size) != 0)
+        {
+            return -1; // Sink aborted
+        }
+        offset += size;
+        reportProgress(offset, progress_memory_bytes);
+    }
+    patch_size = this->new_buffer.size;
+    return 0; // Success
+}
@@ -12,6 +12,19 @@ public:
     int GetAlgoEvalFilePath(std::string& old_file_path, std::string& new_file_path) override;
     int StartEval() override;
     int GetEvalResult(AlgoEvalResult &result) override;
+    int SetAlgoEvalBuffer(const AlgoEvalBuffer& old_buffer, const AlgoEvalBuffer& new_buffer, AlgoPatchSink patch_sink) override;
+    bool IsMemoryEvalSupported() const override { return true; }
+    int ApplyPatchConstrained(ConstrainedApplyEnv& env) override;
+    bool IsConstrainedApplySupported() const override { return true; }
+    bool IsOldIndexSupported() const override { return true; }
+    std::string GetOldIndexTag() const override { return "mock-blockhash-v1"; }
+    int BuildOldIndex(std::vector<uint8_t>& index) override;
+    bool IsReadTraceSupported() const override { return true; }
+    bool IsCancelSupported() const override { return true; }
+
+private:
+    int writeMockPatch(uint64_t& patch_size);
+    int emitMockPatch(uint64_t& patch_size);
 };
 
 #endif // MOCK_ALGO_H
\ No newline at end of file
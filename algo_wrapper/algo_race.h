@@ -0,0 +1,303 @@
+/*
+    Racing evaluation of several algorithms on one input pair
+
+    When only the best engine for a pair matters, all contestants start
+    together and the losers are cut as soon as they cannot win: they run
+    longer than a multiple of the fastest finish, use more than a multiple of
+    the smallest memory, or have already emitted more patch bytes than the
+    smallest finished patch. Cut wrappers are asked to cancel. Wrappers that
+    do not support cancelling run to completion, but their result is discarded.
+    Contestants share the machine, so the times are only good for ranking.
+    A contestant is identified by its position, so one algorithm may race
+    against itself, e.g. to see how much the ranking varies between runs.
+*/
+#ifndef ALGO_RACE_H
+#define ALGO_RACE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <cstdint>
+
+#include "base_algo_wrapper.h"
+#include "algo_registry.h"
+
+enum class RaceOutcome
+{
+    Won, // Smallest patch among the contestants that finished
+    Finished, // Finished but lost
+    Cut, // Cancelled because it could no longer win
+    Failed // StartEval failed on its own
+};
+
+struct RaceConfig
+{
+    double time_factor = 2.0; // Cut when running longer than this times the fastest finish, 0 to disable
+    double memory_factor = 4.0; // Cut when using more than this times the smallest finished memory, 0 to disable
+    bool cut_on_patch_size = true; // Cut when the partial output passes the smallest finished patch
+    int poll_interval_ms = 10;
+    std::string scratch_dir; // Where contestants write their patches, empty for the temporary directory
+};
+
+struct RaceEntry
+{
+    std::string algo_name; // Suffixed with "#n" when the algorithm races more than once
+    RaceOutcome outcome = RaceOutcome::Failed;
+    std::string reason; // Why the contestant was cut
+    double seconds = 0.0; // Until it finished, failed or was cut
+    uint64_t patch_size = 0; // Finished contestants only
+    uint64_t memory = 0; // Reported memory, the live value at the cut for cut contestants
+    uint64_t output_bytes = 0; // Partial output at the cut
+    bool cancel_honoured = false; // The cut wrapper supports cancelling and stopped early instead of running to completion
+};
+
+struct RaceResult
+{
+    std::string winner; // Empty when no contestant finished
+    std::vector<RaceEntry> entries; // In contestant order
+    double wall_seconds = 0.0;
+};
+
+class AlgoRacer
+{
+public:
+    explicit AlgoRacer(const std::vector<std::pair<std::string, AlgoWrapperFactory>>& contestants) : contestants(contestants) {}
+    ~AlgoRacer() = default;
+
+    static const char* GetOutcomeName(RaceOutcome outcome)
+    {
+        switch(outcome)
+        {
+        case RaceOutcome::Won: return "won";
+        case RaceOutcome::Finished: return "finished";
+        case RaceOutcome::Cut: return "cut";
+        default: return "failed";
+        }
+    }
+
+    int Run(const std::string& old_file_path, const std::string& new_file_path, const RaceConfig& config, RaceResult& result)
+    {
+        result = RaceResult();
+        if(contestants.empty() || config.poll_interval_ms <= 0)
+        {
+            return -1; // Nothing to race
+        }
+        std::error_code ec;
+        std::filesystem::path scratch = config.scratch_dir.empty() ? std::filesystem::temp_directory_path(ec) : std::filesystem::path(config.scratch_dir);
+        if(ec)
+        {
+            return -1; // No scratch directory
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::string run_tag = std::to_string(start.time_since_epoch().count());
+        std::vector<std::unique_ptr<Lane>> lanes;
+        for(const auto& contestant : contestants)
+        {
+            auto lane = std::make_unique<Lane>();
+            lane->entry.algo_name = contestant.first;
+            auto same_name = [&contestant](const std::pair<std::string, AlgoWrapperFactory>& other) { return other.first == contestant.first; };
+            if(std::count_if(contestants.begin(), contestants.end(), same_name) > 1)
+            {
+                auto occurrence = std::count_if(contestants.begin(), contestants.begin() + static_cast<std::ptrdiff_t>(lanes.size()) + 1, same_name);
+                lane->entry.algo_name += "#" + std::to_string(occurrence);
+            }
+            lane->wrapper = contestant.second ? contestant.second() : nullptr;
+            // Paths use the lane index, the algorithm name is not unique
+            lane->patch_file_path = (scratch / ("DiffAlgoEval_race_" + run_tag + "_" + std::to_string(lanes.size()) + ".patch")).string();
+            if(!lane->wrapper)
+            {
+                return -1; // Algorithm not registered
+            }
+            lanes.push_back(std::move(lane));
+        }
+        for(auto& lane : lanes)
+        {
+            Lane* lane_ptr = lane.get();
+            lane->thread = std::thread([lane_ptr, &old_file_path, &new_file_path, start]() {
+                runLane(*lane_ptr, old_file_path, new_file_path, start);
+            });
+        }
+
+        Best best;
+        size_t running = lanes.size();
+        while(running > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(config.poll_interval_ms));
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            running = 0;
+            for(auto& lane : lanes)
+            {
+                if(lane->done.load())
+                {
+                    if(!lane->accounted)
+                    {
+                        lane->accounted = true;
+                        accountFinish(*lane, best);
+                    }
+                    continue;
+                }
+                running++;
+                if(!lane->cut)
+                {
+                    checkCut(*lane, config, best, elapsed);
+                }
+            }
+        }
+        for(auto& lane : lanes)
+        {
+            lane->thread.join();
+            std::filesystem::remove(lane->patch_file_path, ec); // Best effort
+        }
+        result.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // Smallest patch wins, the faster one on a tie
+        RaceEntry* winner = nullptr;
+        for(auto& lane : lanes)
+        {
+            RaceEntry& entry = lane->entry;
+            if(entry.outcome == RaceOutcome::Finished
+                && (winner == nullptr || entry.patch_size < winner->patch_size
+                    || (entry.patch_size == winner->patch_size && entry.seconds < winner->seconds)))
+            {
+                winner = &entry;
+            }
+        }
+        if(winner != nullptr)
+        {
+            winner->outcome = RaceOutcome::Won;
+            result.winner = winner->algo_name;
+        }
+        for(auto& lane : lanes)
+        {
+            result.entries.push_back(lane->entry);
+        }
+        return 0; // Success
+    }
+
+private:
+    struct Lane
+    {
+        std::unique_ptr<BaseAlgoWrapper> wrapper;
+        std::string patch_file_path;
+        std::thread thread;
+        std::atomic<bool> done{false};
+        int ret = -1; // Written by the lane thread before done is set
+        AlgoEvalResult eval_result;
+        double finish_seconds = 0.0;
+        bool accounted = false; // The monitor has seen it finish
+        bool cut = false;
+        RaceEntry entry;
+    };
+
+    struct Best
+    {
+        bool has_finish = false;
+        double seconds = 0.0;
+        uint64_t memory = 0;
+        uint64_t patch_size = 0;
+    };
+
+    static void runLane(Lane& lane, const std::string& old_file_path, const std::string& new_file_path,
+                        std::chrono::steady_clock::time_point start)
+    {
+        BaseAlgoWrapper& wrapper = *lane.wrapper;
+        bool finished = false;
+        lane.ret = (wrapper.SetAlgoEvalFilePath(old_file_path, new_file_path) == 0
+                    && wrapper.SetAlgoEvalPatchPath(lane.patch_file_path) == 0
+                    && wrapper.StartEval() == 0
+                    && wrapper.GetEvalResult(lane.eval_result) == 0
+                    && lane.eval_result.IsEvalFinished(finished) == 0
+                    && finished) ? 0 : -1;
+        lane.finish_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        lane.done = true;
+    }
+
+    static void accountFinish(Lane& lane, Best& best)
+    {
+        RaceEntry& entry = lane.entry;
+        if(lane.cut)
+        {
+            // Only a wrapper that supports cancelling can honour it; others failing after the cut failed on their own
+            entry.cancel_honoured = lane.wrapper->IsCancelSupported() && lane.ret != 0;
+            return;
+        }
+        entry.seconds = lane.finish_seconds;
+        uint64_t patch_size = 0;
+        if(lane.ret != 0 || lane.eval_result.GetEvalPatchSize(patch_size) != 0)
+        {
+            entry.outcome = RaceOutcome::Failed;
+            return;
+        }
+        std::string unused_path, unused_md5;
+        std::chrono::duration<double> duration;
+        uint64_t cpu = 0;
+        if(lane.eval_result.GetEvalResult(unused_path, unused_path, unused_md5, unused_md5, duration, entry.memory, cpu) != 0)
+        {
+            entry.outcome = RaceOutcome::Failed;
+            return;
+        }
+        entry.outcome = RaceOutcome::Finished;
+        entry.patch_size = patch_size;
+        if(!best.has_finish)
+        {
+            best.has_finish = true;
+            best.seconds = entry.seconds;
+            best.memory = entry.memory;
+            best.patch_size = entry.patch_size;
+            return;
+        }
+        best.seconds = std::min(best.seconds, entry.seconds);
+        best.memory = std::min(best.memory, entry.memory);
+        best.patch_size = std::min(best.patch_size, entry.patch_size);
+    }
+
+    static void checkCut(Lane& lane, const RaceConfig& config, const Best& best, double elapsed)
+    {
+        if(!best.has_finish)
+        {
+            return; // Nothing to compare against yet
+        }
+        AlgoEvalProgress progress;
+        lane.wrapper->GetProgress(progress);
+        std::ostringstream reason;
+        reason << std::fixed << std::setprecision(3);
+        if(config.time_factor > 0.0 && elapsed > config.time_factor * best.seconds)
+        {
+            reason << "running " << elapsed << " s, over " << config.time_factor << " x the fastest finish of " << best.seconds << " s";
+        }
+        else if(config.memory_factor > 0.0 && best.memory > 0
+                && static_cast<double>(progress.memory_bytes) > config.memory_factor * static_cast<double>(best.memory))
+        {
+            reason << "using " << progress.memory_bytes << " bytes, over " << config.memory_factor << " x the smallest finished memory of "
+                   << best.memory << " bytes";
+        }
+        else if(config.cut_on_patch_size && progress.output_bytes > best.patch_size)
+        {
+            reason << "emitted " << progress.output_bytes << " bytes, more than the smallest finished patch of " << best.patch_size << " bytes";
+        }
+        else
+        {
+            return; // Still in the race
+        }
+        lane.cut = true;
+        lane.wrapper->RequestCancel();
+        lane.entry.outcome = RaceOutcome::Cut;
+        lane.entry.reason = reason.str();
+        lane.entry.seconds = elapsed;
+        lane.entry.memory = progress.memory_bytes;
+        lane.entry.output_bytes = progress.output_bytes;
+    }
+
+    std::vector<std::pair<std::string, AlgoWrapperFactory>> contestants;
+};
+
+#endif // ALGO_RACE_H
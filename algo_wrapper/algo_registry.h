@@ -0,0 +1,77 @@
+/*
+    Name based registry of algorithm wrappers
+*/
+#ifndef ALGO_REGISTRY_H
+#define ALGO_REGISTRY_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <functional>
+
+#include "base_algo_wrapper.h"
+
+using AlgoWrapperFactory = std::function<std::unique_ptr<BaseAlgoWrapper>()>;
+
+class AlgoRegistry
+{
+public:
+    static AlgoRegistry& Instance()
+    {
+        static AlgoRegistry registry;
+        return registry;
+    }
+
+    int Register(const std::string& algo_name, AlgoWrapperFactory factory)
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex); // Lock the mutex for thread safety
+        if(algo_name.empty() || !factory)
+        {
+            return -1; // Invalid algorithm name or factory
+        }
+        factories[algo_name] = std::move(factory);
+        return 0; // Success
+    }
+
+    std::unique_ptr<BaseAlgoWrapper> Create(const std::string& algo_name)
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex); // Lock the mutex for thread safety
+        auto it = factories.find(algo_name);
+        if(it == factories.end())
+        {
+            return nullptr; // Algorithm not registered
+        }
+        return it->second();
+    }
+
+    AlgoWrapperFactory GetFactory(const std::string& algo_name)
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex); // Lock the mutex for thread safety
+        auto it = factories.find(algo_name);
+        if(it == factories.end())
+        {
+            return nullptr; // Algorithm not registered
+        }
+        return it->second;
+    }
+
+    std::vector<std::string> GetAlgoNames()
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex); // Lock the mutex for thread safety
+        std::vector<std::string> names;
+        for(const auto& pair : factories)
+        {
+            names.push_back(pair.first);
+        }
+        return names;
+    }
+
+private:
+    AlgoRegistry() = default;
+    std::map<std::string, AlgoWrapperFactory> factories;
+    std::mutex registry_mutex; // Mutex for thread safety
+};
+
+#endif // ALGO_REGISTRY_H
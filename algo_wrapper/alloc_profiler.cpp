@@ -0,0 +1,396 @@
+#include "alloc_profiler.h"
+
+#include <new>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+// Global operator new/delete replacements. Blocks come straight from the C
+// allocator without a header, the freed size is read back from the allocator,
+// so the replacement costs nothing but a thread local load while no profile
+// runs on the calling thread. With glibc the C allocation functions are
+// replaced too (forwarding to the __libc_ entry points), which also catches C
+// engines that call malloc directly; operator new then counts through malloc.
+
+#if defined(__GLIBC__)
+#define DAE_ALLOC_PROFILE_MALLOC 1
+#endif
+
+namespace
+{
+
+// Counters of the profile running on the owning thread. Plain values, only that
+// thread touches them, and constant initialized so using them never allocates.
+struct ThreadProfile
+{
+    bool active;
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t bytes_allocated;
+    uint64_t bytes_freed;
+    int64_t live_bytes; // Usable bytes allocated minus freed since Begin(), can go negative
+    int64_t peak_live_bytes;
+    uint64_t size_classes[AlgoEvalAllocStats::SizeClassCount];
+};
+
+thread_local ThreadProfile thread_profile = {};
+
+size_t usableSize(void* ptr, size_t alignment)
+{
+#if defined(_WIN32)
+    return alignment > 0 ? _aligned_msize(ptr, alignment, 0) : _msize(ptr);
+#elif defined(__APPLE__)
+    (void)alignment;
+    return malloc_size(ptr);
+#else
+    (void)alignment;
+    return malloc_usable_size(ptr);
+#endif
+}
+
+void recordAllocation(void* ptr, size_t size, size_t alignment)
+{
+    ThreadProfile& profile = thread_profile;
+    if(!profile.active || ptr == nullptr)
+    {
+        return;
+    }
+    profile.allocations++;
+    profile.bytes_allocated += size;
+    profile.size_classes[AlgoEvalAllocStats::GetSizeClass(size)]++;
+    profile.live_bytes += static_cast<int64_t>(usableSize(ptr, alignment));
+    profile.peak_live_bytes = std::max(profile.peak_live_bytes, profile.live_bytes);
+}
+
+void recordFreeSize(size_t usable_size)
+{
+    ThreadProfile& profile = thread_profile;
+    profile.frees++;
+    profile.bytes_freed += usable_size;
+    profile.live_bytes -= static_cast<int64_t>(usable_size);
+}
+
+void recordFree(void* ptr, size_t alignment)
+{
+    if(ptr == nullptr || !thread_profile.active)
+    {
+        return;
+    }
+    recordFreeSize(usableSize(ptr, alignment));
+}
+
+// Bookkeeping cost of one allocation plus one free, measured once outside any timed window
+double bookkeepingSeconds()
+{
+    static const double seconds = []() {
+        constexpr int rounds = 4096;
+        ThreadProfile saved = thread_profile;
+        void* block = std::malloc(64);
+        thread_profile = ThreadProfile();
+        thread_profile.active = true;
+        auto start = std::chrono::steady_clock::now();
+        for(int round = 0; round < rounds; round++)
+        {
+            recordAllocation(block, 64, 0);
+            recordFree(block, 0);
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        thread_profile = saved;
+        std::free(block);
+        return elapsed / rounds;
+    }();
+    return seconds;
+}
+
+void* allocate(size_t size, size_t alignment, bool nothrow)
+{
+    if(size == 0)
+    {
+        size = 1; // new must return a unique pointer
+    }
+    for(;;)
+    {
+        void* ptr = nullptr;
+        if(alignment == 0)
+        {
+            ptr = std::malloc(size);
+        }
+        else
+        {
+#if defined(_WIN32)
+            ptr = _aligned_malloc(size, alignment);
+#else
+            if(posix_memalign(&ptr, alignment, size) != 0)
+            {
+                ptr = nullptr;
+            }
+#endif
+        }
+        if(ptr != nullptr)
+        {
+#if !defined(DAE_ALLOC_PROFILE_MALLOC)
+            recordAllocation(ptr, size, alignment); // Otherwise counted by the malloc replacement
+#endif
+            return ptr;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if(handler == nullptr)
+        {
+            if(nothrow)
+            {
+                return nullptr;
+            }
+            throw std::bad_alloc();
+        }
+        if(nothrow)
+        {
+            try
+            {
+                handler();
+            }
+            catch(...)
+            {
+                return nullptr;
+            }
+        }
+        else
+        {
+            handler();
+        }
+    }
+}
+
+void deallocate(void* ptr, size_t alignment)
+{
+    if(ptr == nullptr)
+    {
+        return;
+    }
+#if defined(DAE_ALLOC_PROFILE_MALLOC)
+    (void)alignment; // Counted by the free replacement
+#else
+    recordFree(ptr, alignment);
+#endif
+#if defined(_WIN32)
+    if(alignment > 0)
+    {
+        _aligned_free(ptr);
+        return;
+    }
+#endif
+    std::free(ptr);
+}
+
+} // namespace
+
+#if defined(DAE_ALLOC_PROFILE_MALLOC)
+extern "C"
+{
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size)
+{
+    void* ptr = __libc_malloc(size);
+    recordAllocation(ptr, size, 0);
+    return ptr;
+}
+
+void* calloc(size_t count, size_t size)
+{
+    void* ptr = __libc_calloc(count, size);
+    recordAllocation(ptr, count * size, 0);
+    return ptr;
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    size_t old_size = (ptr != nullptr && thread_profile.active) ? usableSize(ptr, 0) : 0;
+    void* new_ptr = __libc_realloc(ptr, size);
+    if(new_ptr == nullptr && size != 0)
+    {
+        return nullptr; // The old block is untouched
+    }
+    if(ptr != nullptr && thread_profile.active)
+    {
+        recordFreeSize(old_size);
+    }
+    recordAllocation(new_ptr, size, 0);
+    return new_ptr;
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    void* ptr = __libc_memalign(alignment, size);
+    recordAllocation(ptr, size, alignment);
+    return ptr;
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+    if(alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+    {
+        return EINVAL;
+    }
+    void* block = memalign(alignment, size);
+    if(block == nullptr)
+    {
+        return ENOMEM;
+    }
+    *ptr = block;
+    return 0;
+}
+
+void free(void* ptr)
+{
+    recordFree(ptr, 0);
+    __libc_free(ptr);
+}
+
+} // extern "C"
+#endif
+
+int AllocProfiler::Begin()
+{
+    if(thread_profile.active)
+    {
+        return -1; // A profile is already running on this thread
+    }
+    bookkeepingSeconds(); // Calibrate before the first profile starts
+    thread_profile = ThreadProfile();
+    thread_profile.active = true;
+    return 0; // Success
+}
+
+int AllocProfiler::End(AlgoEvalAllocStats& alloc_stats)
+{
+    if(!thread_profile.active)
+    {
+        return -1; // No profile running on this thread
+    }
+    ThreadProfile profile = thread_profile;
+    thread_profile.active = false;
+    alloc_stats = AlgoEvalAllocStats();
+    alloc_stats.profiled = true;
+#if defined(DAE_ALLOC_PROFILE_MALLOC)
+    alloc_stats.malloc_tracked = true;
+#endif
+    alloc_stats.allocations = profile.allocations;
+    alloc_stats.frees = profile.frees;
+    alloc_stats.bytes_allocated = profile.bytes_allocated;
+    alloc_stats.bytes_freed = profile.bytes_freed;
+    alloc_stats.peak_live_bytes = static_cast<uint64_t>(profile.peak_live_bytes);
+    for(int size_class = 0; size_class < AlgoEvalAllocStats::SizeClassCount; size_class++)
+    {
+        alloc_stats.size_classes[size_class] = profile.size_classes[size_class];
+    }
+    alloc_stats.overhead_seconds = bookkeepingSeconds() * static_cast<double>(std::max(profile.allocations, profile.frees));
+    return 0; // Success
+}
+
+bool AllocProfiler::IsActive()
+{
+    return thread_profile.active;
+}
+
+void* operator new(std::size_t size)
+{
+    return allocate(size, 0, false);
+}
+void* operator new[](std::size_t size)
+{
+    return allocate(size, 0, false);
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size, 0, true);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size, 0, true);
+}
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return allocate(size, static_cast<size_t>(alignment), false);
+}
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return allocate(size, static_cast<size_t>(alignment), false);
+}
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocate(size, static_cast<size_t>(alignment), true);
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocate(size, static_cast<size_t>(alignment), true);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    deallocate(ptr, 0);
+}
+void operator delete[](void* ptr) noexcept
+{
+    deallocate(ptr, 0);
+}
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    deallocate(ptr, 0);
+}
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    deallocate(ptr, 0);
+}
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    deallocate(ptr, 0);
+}
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    deallocate(ptr, 0);
+}
+void operator delete(void* ptr, std::align_val_t alignment) noexcept
+{
+    deallocate(ptr, static_cast<size_t>(alignment));
+}
+void operator delete[](void* ptr, std::align_val_t alignment) noexcept
+{
+    deallocate(ptr, static_cast<size_t>(alignment));
+}
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept
+{
+    deallocate(ptr, static_cast<size_t>(alignment));
+}
+void operator delete[](void* ptr, std::size_t, std::align_val_t alignment) noexcept
+{
+    deallocate(ptr, static_cast<size_t>(alignment));
+}
+void operator delete(void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    deallocate(ptr, static_cast<size_t>(alignment));
+}
+void operator delete[](void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    deallocate(ptr, static_cast<size_t>(alignment));
+}
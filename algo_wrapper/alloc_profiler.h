@@ -0,0 +1,58 @@
+/*
+    Heap allocation profiling for evaluations
+
+    alloc_profiler.cpp replaces the global operator new/delete of the
+    executable it is linked into and, with glibc, malloc, calloc, realloc, the
+    aligned variants and free as well, so C engines are seen too. Elsewhere
+    only C++ allocations are counted. A profile counts the allocations of the
+    thread that started it, so other threads (loaders, the GUI, concurrent
+    evaluations) do not leak into it, but neither do threads the engine starts
+    itself. The bookkeeping runs inside the measured window; its estimated cost
+    is reported as overhead_seconds.
+*/
+#ifndef ALLOC_PROFILER_H
+#define ALLOC_PROFILER_H
+
+#include "base_algo_wrapper.h"
+
+class AllocProfiler
+{
+public:
+    static int Begin(); // Fails when a profile is already active on the calling thread
+    static int End(AlgoEvalAllocStats& alloc_stats);
+    static bool IsActive(); // On the calling thread
+};
+
+// Profiles the enclosing scope, stats are available after Finish()
+class ScopedAllocProfile
+{
+public:
+    explicit ScopedAllocProfile(bool enabled)
+    {
+        active = enabled && AllocProfiler::Begin() == 0;
+    }
+    ~ScopedAllocProfile()
+    {
+        AlgoEvalAllocStats unused;
+        Finish(unused);
+    }
+    ScopedAllocProfile(const ScopedAllocProfile&) = delete;
+    ScopedAllocProfile& operator=(const ScopedAllocProfile&) = delete;
+
+    bool IsActive() const { return active; }
+
+    int Finish(AlgoEvalAllocStats& alloc_stats)
+    {
+        if(!active)
+        {
+            return -1; // Not profiling
+        }
+        active = false;
+        return AllocProfiler::End(alloc_stats);
+    }
+
+private:
+    bool active = false;
+};
+
+#endif // ALLOC_PROFILER_H
@@ -5,16 +5,163 @@
 #define BASE_ALGO_WRAPPER_H
 
 #include <string>
+#include <vector>
 #include <chrono>
 #include <ctime>
 #include <mutex>
+#include <atomic>
 #include <filesystem>
+#include <functional>
 #include <cstdint>
+#include <cstddef>
 
 #include <QCryptographicHash>
 #include <QFile>
 #include <QIODevice>
 #include <QByteArrayView>
+
+#include "old_index_cache.h"
+#include "io_profile.h"
+
+enum class AlgoEvalIoMode
+{
+    File, // Inputs are read from and the patch is written to the filesystem by the wrapper
+    Memory // Inputs are caller owned buffers and the patch goes to a sink, no disk I/O is measured
+};
+
+struct AlgoEvalBuffer
+{
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// Receives the patch in one or more chunks, returns 0 to continue or -1 to abort
+using AlgoPatchSink = std::function<int(const uint8_t* data, size_t size)>;
+
+struct ConstrainedApplyEnv; // See target_sim.h
+
+// Execution environment an evaluation ran in, filled by the runner (see exec_env.h)
+struct AlgoEvalEnv
+{
+    std::string cpu_model;
+    std::string cpu_governor; // Empty when the platform does not expose it
+    double cpu_freq_mhz = 0.0; // Observed frequency averaged over the pinned CPUs, 0 when unknown
+    double cpu_freq_max_mhz = 0.0;
+    double load_avg = -1.0; // 1 minute load average, negative when unavailable
+    double other_load = -1.0; // load_avg without the evaluating process's own share, negative when unavailable
+    std::vector<int> cpu_set; // CPUs the evaluation was pinned to, empty when not pinned
+    int numa_node = -1; // NUMA node of the pinned CPUs, -1 when unknown or mixed
+    std::vector<std::string> warnings; // Conditions that make the numbers less trustworthy
+    double capture_seconds = 0.0; // Steady clock time of the snapshot, used by MergeSnapshots()
+    double process_cpu_seconds = -1.0; // CPU time of the whole process at the snapshot, negative when unavailable
+};
+
+// Heap allocation statistics of one evaluation, filled by the runner (see alloc_profiler.h)
+struct AlgoEvalAllocStats
+{
+    static constexpr int SizeClassCount = 8; // <=16, <=64, <=256, <=1K, <=4K, <=64K, <=1M, >1M bytes
+
+    bool profiled = false; // False when the evaluation ran without allocation tracking
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t bytes_allocated = 0; // Requested bytes
+    uint64_t bytes_freed = 0; // Usable bytes of the freed blocks, may include blocks allocated before the evaluation
+    uint64_t peak_live_bytes = 0; // Highest heap growth over the start of the evaluation
+    uint64_t size_classes[SizeClassCount] = {}; // Allocation count per requested size class
+    bool malloc_tracked = false; // C allocations (malloc and friends) are included, not only new/delete
+    double overhead_seconds = 0.0; // Estimated time the bookkeeping added to the measured duration
+
+    static int GetSizeClass(size_t size)
+    {
+        static const size_t limits[SizeClassCount - 1] = {16, 64, 256, 1024, 4096, 65536, 1048576};
+        for(int size_class = 0; size_class < SizeClassCount - 1; size_class++)
+        {
+            if(size <= limits[size_class])
+            {
+                return size_class;
+            }
+        }
+        return SizeClassCount - 1;
+    }
+    static const char* GetSizeClassName(int size_class)
+    {
+        static const char* names[SizeClassCount] = {"<=16", "<=64", "<=256", "<=1K", "<=4K", "<=64K", "<=1M", ">1M"};
+        return (size_class >= 0 && size_class < SizeClassCount) ? names[size_class] : "";
+    }
+};
+
+// Cost of one preprocessing stage applied to both inputs ahead of StartEval (see preprocess.h)
+struct AlgoPreprocessStage
+{
+    std::string name;
+    double seconds = 0.0; // Old and new input together
+    uint64_t peak_memory = 0; // Highest peak live heap of the stage over both inputs, see memory_measured
+    bool memory_measured = false; // False when a run of the stage could not be profiled
+    uint64_t input_bytes = 0;
+    uint64_t output_bytes = 0;
+};
+
+enum class AlgoContentKind
+{
+    Unknown, // Empty input
+    Text,
+    Binary,
+    Executable, // ELF, PE or Mach-O
+    Compressed // Known compressed format or high entropy throughout
+};
+
+// Cheap pre-analysis of an input pair, filled by the runner (see input_profile.h)
+struct AlgoInputProfile
+{
+    bool analyzed = false;
+    double similarity = 0.0; // Estimated Jaccard similarity of the 64 byte windows of both inputs
+    double old_entropy = 0.0; // Mean bits per byte over 4 KiB blocks
+    double new_entropy = 0.0;
+    double new_high_entropy_ratio = 0.0; // Share of new blocks above 7.5 bits per byte
+    AlgoContentKind old_kind = AlgoContentKind::Unknown;
+    AlgoContentKind new_kind = AlgoContentKind::Unknown;
+    uint64_t old_size = 0;
+    uint64_t new_size = 0;
+    double seconds = 0.0; // Time the analysis took, not part of the evaluation
+
+    static const char* GetContentKindName(AlgoContentKind kind)
+    {
+        switch(kind)
+        {
+        case AlgoContentKind::Text: return "text";
+        case AlgoContentKind::Binary: return "binary";
+        case AlgoContentKind::Executable: return "executable";
+        case AlgoContentKind::Compressed: return "compressed";
+        default: return "unknown";
+        }
+    }
+    static AlgoContentKind ParseContentKind(const std::string& name)
+    {
+        for(AlgoContentKind kind : {AlgoContentKind::Text, AlgoContentKind::Binary, AlgoContentKind::Executable, AlgoContentKind::Compressed})
+        {
+            if(name == GetContentKindName(kind))
+            {
+                return kind;
+            }
+        }
+        return AlgoContentKind::Unknown;
+    }
+};
+
+// Live progress of a running StartEval, readable from other threads
+struct AlgoEvalProgress
+{
+    uint64_t output_bytes = 0; // Patch bytes emitted so far
+    uint64_t memory_bytes = 0; // Memory in use as the wrapper accounts it, 0 when unknown
+};
+
+enum class AlgoOldIndexState
+{
+    None, // The wrapper does not index the old file
+    Built, // The index was built during this evaluation
+    Reused // The index came from the OldIndexCache
+};
+
 class AlgoEvalResult
 {
 public:
@@ -26,12 +173,23 @@ public:
           eval_new_file_path(other.eval_new_file_path),
           eval_old_file_md5(other.eval_old_file_md5),
           eval_new_file_md5(other.eval_new_file_md5),
+          eval_io_mode(other.eval_io_mode),
           eval_finshed(other.eval_finshed),
           eval_start_time(other.eval_start_time),
           eval_finish_time(other.eval_finish_time),
           eval_duration(other.eval_duration),
           eval_occupy_memory(other.eval_occupy_memory),
-          eval_occupy_cpu(other.eval_occupy_cpu)
+          eval_occupy_cpu(other.eval_occupy_cpu),
+          eval_patch_size(other.eval_patch_size),
+          eval_old_index_state(other.eval_old_index_state),
+          eval_old_index_build_duration(other.eval_old_index_build_duration),
+          eval_alloc_stats(other.eval_alloc_stats),
+          eval_preprocess(other.eval_preprocess),
+          eval_preprocess_stages(other.eval_preprocess_stages),
+          eval_io_stats(other.eval_io_stats),
+          eval_old_read_access(other.eval_old_read_access),
+          eval_input_profile(other.eval_input_profile),
+          eval_env(other.eval_env)
     {
     }
     AlgoEvalResult& operator=(const AlgoEvalResult& other)
@@ -44,12 +202,23 @@ public:
             eval_new_file_path = other.eval_new_file_path;
             eval_old_file_md5 = other.eval_old_file_md5;
             eval_new_file_md5 = other.eval_new_file_md5;
+            eval_io_mode = other.eval_io_mode;
             eval_finshed = other.eval_finshed;
             eval_start_time = other.eval_start_time;
             eval_finish_time = other.eval_finish_time;
             eval_duration = other.eval_duration;
             eval_occupy_memory = other.eval_occupy_memory;
             eval_occupy_cpu = other.eval_occupy_cpu;
+            eval_patch_size = other.eval_patch_size;
+            eval_old_index_state = other.eval_old_index_state;
+            eval_old_index_build_duration = other.eval_old_index_build_duration;
+            eval_alloc_stats = other.eval_alloc_stats;
+            eval_preprocess = other.eval_preprocess;
+            eval_preprocess_stages = other.eval_preprocess_stages;
+            eval_io_stats = other.eval_io_stats;
+            eval_old_read_access = other.eval_old_read_access;
+            eval_input_profile = other.eval_input_profile;
+            eval_env = other.eval_env;
         }
         return *this;
     }
@@ -60,17 +229,28 @@ public:
         eval_new_file_path = "";
         eval_old_file_md5 = "";
         eval_new_file_md5 = "";
+        eval_io_mode = AlgoEvalIoMode::File;
         eval_duration = std::chrono::duration<double>(0);
         eval_start_time = std::chrono::system_clock::time_point();
         eval_finish_time = std::chrono::system_clock::time_point();
         eval_occupy_memory = 0;
         eval_occupy_cpu = 0;
+        eval_patch_size = 0;
+        eval_old_index_state = AlgoOldIndexState::None;
+        eval_old_index_build_duration = std::chrono::duration<double>(0);
+        eval_alloc_stats = AlgoEvalAllocStats();
+        eval_preprocess = "";
+        eval_preprocess_stages.clear();
+        eval_io_stats = AlgoEvalIoStats();
+        eval_old_read_access = AlgoIoAccessSummary();
+        eval_input_profile = AlgoInputProfile();
+        eval_env = AlgoEvalEnv();
     }
 
     int IsEvalFinished(bool& isFinished)
     {
         std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
-        if(eval_old_file_path.empty() || eval_new_file_path.empty())
+        if(eval_io_mode == AlgoEvalIoMode::File && (eval_old_file_path.empty() || eval_new_file_path.empty()))
         {
             return -1; // File paths are not set
         }
@@ -101,18 +281,69 @@ public:
             return -1; // File paths are not readable
         }
         
-        if(calculateFileMD5(old_file_path, old_file_md5) != 0)
+        if(!preset_old_md5.empty() && !preset_new_md5.empty())
+        {
+            old_file_md5 = preset_old_md5; // Hashed ahead of time by the caller
+            new_file_md5 = preset_new_md5;
+        }
+        else if(calculateFileMD5(old_file_path, old_file_md5) != 0)
         {
             return -1; // Failed to calculate MD5 for old file
         }
-        if(calculateFileMD5(new_file_path, new_file_md5) != 0)
+        else if(calculateFileMD5(new_file_path, new_file_md5) != 0)
         {
             return -1; // Failed to calculate MD5 for new file
         }
+        preset_old_md5.clear();
+        preset_new_md5.clear();
         eval_old_file_md5 = old_file_md5;
         eval_new_file_md5 = new_file_md5;
         eval_old_file_path = old_file_path;
         eval_new_file_path = new_file_path;
+        eval_io_mode = AlgoEvalIoMode::File;
+        return 0; // Success
+    }
+    int SetEvalBuffers(const AlgoEvalBuffer& old_buffer, const AlgoEvalBuffer& new_buffer)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+
+        if((old_buffer.data == nullptr && old_buffer.size != 0) || (new_buffer.data == nullptr && new_buffer.size != 0))
+        {
+            return -1; // Invalid buffers
+        }
+        bool preset = !preset_old_md5.empty() && !preset_new_md5.empty();
+        eval_old_file_md5 = preset ? preset_old_md5 : calculateBufferMD5(old_buffer);
+        eval_new_file_md5 = preset ? preset_new_md5 : calculateBufferMD5(new_buffer);
+        preset_old_md5.clear();
+        preset_new_md5.clear();
+        eval_old_file_path = "";
+        eval_new_file_path = "";
+        eval_io_mode = AlgoEvalIoMode::Memory;
+        return 0; // Success
+    }
+    // Hashes of the inputs computed ahead of time (see prefetch_loader.h), used by the
+    // next SetEvalFiles() or SetEvalBuffers() instead of hashing the inputs again
+    int SetEvalInputHashes(const std::string& old_file_md5, const std::string& new_file_md5)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        if(old_file_md5.empty() || new_file_md5.empty())
+        {
+            return -1; // Invalid hashes
+        }
+        preset_old_md5 = old_file_md5;
+        preset_new_md5 = new_file_md5;
+        return 0; // Success
+    }
+    // Hashes of the current inputs, available once SetEvalFiles() or SetEvalBuffers() ran
+    int GetEvalInputHashes(std::string& old_file_md5, std::string& new_file_md5)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        if(eval_old_file_md5.empty() || eval_new_file_md5.empty())
+        {
+            return -1; // Inputs are not set
+        }
+        old_file_md5 = eval_old_file_md5;
+        new_file_md5 = eval_new_file_md5;
         return 0; // Success
     }
     int SetEvalFinished()
@@ -124,7 +355,7 @@ public:
             return -1; // Evaluation already finished or not finished
         }
         do{
-            if(eval_old_file_path.empty() || eval_new_file_path.empty())
+            if(eval_io_mode == AlgoEvalIoMode::File && (eval_old_file_path.empty() || eval_new_file_path.empty()))
             {
                 need_clear = true;
                 break;
@@ -178,6 +409,9 @@ public:
         eval_finish_time = std::chrono::system_clock::time_point();
         eval_occupy_memory = 0;
         eval_occupy_cpu = 0;
+        eval_patch_size = 0;
+        eval_old_index_state = AlgoOldIndexState::None;
+        eval_old_index_build_duration = std::chrono::duration<double>(0);
         eval_start_time = std::chrono::system_clock::now(); // Get the current time
 
         return 0; // Success
@@ -194,6 +428,12 @@ public:
         eval_occupy_cpu = cpu; // Set the CPU usage
         return 0; // Success
     }
+    int SetEvalPatchSize(uint64_t patch_size)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        eval_patch_size = patch_size; // Set the generated patch size
+        return 0; // Success
+    }
     
     int GetEvalResult(std::string& old_file_path, 
                         std::string& new_file_path, 
@@ -217,6 +457,134 @@ public:
         cpu = eval_occupy_cpu;
         return 0; // Success
     }
+    int GetEvalPatchSize(uint64_t& patch_size)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        if(eval_finshed == false)
+        {
+            return -1; // Evaluation not finished
+        }
+        patch_size = eval_patch_size;
+        return 0; // Success
+    }
+    int SetEvalOldIndex(AlgoOldIndexState state, std::chrono::duration<double> build_duration)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        eval_old_index_state = state;
+        eval_old_index_build_duration = build_duration; // Zero unless the index was built
+        return 0; // Success
+    }
+    // The incremental duration is the per-target cost: the total minus the index build
+    int GetEvalOldIndex(AlgoOldIndexState& state,
+                        std::chrono::duration<double>& build_duration,
+                        std::chrono::duration<double>& incremental_duration)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        if(eval_finshed == false)
+        {
+            return -1; // Evaluation not finished
+        }
+        state = eval_old_index_state;
+        build_duration = eval_old_index_build_duration;
+        incremental_duration = eval_duration - eval_old_index_build_duration;
+        if(incremental_duration.count() < 0)
+        {
+            incremental_duration = std::chrono::duration<double>(0); // Duration is rounded to milliseconds
+        }
+        return 0; // Success
+    }
+    static const char* GetOldIndexStateName(AlgoOldIndexState state)
+    {
+        switch(state)
+        {
+        case AlgoOldIndexState::Built: return "built";
+        case AlgoOldIndexState::Reused: return "reused";
+        default: return "none";
+        }
+    }
+    int SetEvalAllocStats(const AlgoEvalAllocStats& alloc_stats)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        eval_alloc_stats = alloc_stats; // Set the heap allocation statistics
+        return 0; // Success
+    }
+    int GetEvalAllocStats(AlgoEvalAllocStats& alloc_stats)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        alloc_stats = eval_alloc_stats;
+        return 0; // Success
+    }
+    int SetEvalPreprocess(const std::string& pipeline_name, const std::vector<AlgoPreprocessStage>& stages)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        eval_preprocess = pipeline_name; // Empty when the inputs were diffed raw
+        eval_preprocess_stages = stages;
+        return 0; // Success
+    }
+    int GetEvalPreprocess(std::string& pipeline_name, std::vector<AlgoPreprocessStage>& stages)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        pipeline_name = eval_preprocess;
+        stages = eval_preprocess_stages;
+        return 0; // Success
+    }
+    int SetEvalIoStats(const AlgoEvalIoStats& io_stats)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        eval_io_stats = io_stats; // Set the I/O counter deltas
+        return 0; // Success
+    }
+    int GetEvalIoStats(AlgoEvalIoStats& io_stats)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        io_stats = eval_io_stats;
+        return 0; // Success
+    }
+    int SetEvalOldReadAccess(const AlgoIoAccessSummary& access)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        eval_old_read_access = access; // Set the access pattern of the old input
+        return 0; // Success
+    }
+    int GetEvalOldReadAccess(AlgoIoAccessSummary& access)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        access = eval_old_read_access;
+        return 0; // Success
+    }
+    int SetEvalInputProfile(const AlgoInputProfile& input_profile)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        eval_input_profile = input_profile; // Set the pre-analysis of the inputs
+        return 0; // Success
+    }
+    int GetEvalInputProfile(AlgoInputProfile& input_profile)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        input_profile = eval_input_profile;
+        return 0; // Success
+    }
+    int SetEvalEnv(const AlgoEvalEnv& env)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        eval_env = env; // Set the execution environment
+        return 0; // Success
+    }
+    int GetEvalEnv(AlgoEvalEnv& env)
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        env = eval_env;
+        return 0; // Success
+    }
+    AlgoEvalIoMode GetEvalIoMode()
+    {
+        std::lock_guard<std::mutex> lock(eval_mutex); // Lock the mutex for thread safety
+        return eval_io_mode;
+    }
+    static const char* GetEvalIoModeName(AlgoEvalIoMode io_mode)
+    {
+        return io_mode == AlgoEvalIoMode::Memory ? "memory" : "file";
+    }
 private:
     bool isReadableFile(const std::string& filePath) {
         std::filesystem::path path(filePath);
@@ -261,6 +629,11 @@ private:
         md5Hash = md5.result().toHex().toStdString(); // Convert to string
         return 0;
     }
+    std::string calculateBufferMD5(const AlgoEvalBuffer& buffer)
+    {
+        QByteArrayView view(reinterpret_cast<const char*>(buffer.data), static_cast<qsizetype>(buffer.size));
+        return QCryptographicHash::hash(view, QCryptographicHash::Md5).toHex().toStdString();
+    }
     std::chrono::duration<double> timeDifferenceMilliseconds(std::chrono::system_clock::time_point &pre_time, 
                                         std::chrono::system_clock::time_point &post_time) {
         auto diff = post_time - pre_time;
@@ -271,16 +644,29 @@ public:
     std::string eval_new_file_path;
     std::string eval_old_file_md5;
     std::string eval_new_file_md5;
-    bool eval_finshed; // Evaluation finished flag
+    AlgoEvalIoMode eval_io_mode = AlgoEvalIoMode::File; // Which input/output path was measured
+    bool eval_finshed = false; // Evaluation finished flag
 
     std::chrono::system_clock::time_point eval_start_time;
     std::chrono::system_clock::time_point eval_finish_time;
-    std::chrono::duration<double> eval_duration;
+    std::chrono::duration<double> eval_duration{0};
 
-    uint64_t eval_occupy_memory; // Memory usage in bytes
-    uint64_t eval_occupy_cpu; // CPU usage in percentage
+    uint64_t eval_occupy_memory = 0; // Memory usage in bytes
+    uint64_t eval_occupy_cpu = 0; // CPU usage in percentage
+    uint64_t eval_patch_size = 0; // Generated patch size in bytes
+    AlgoOldIndexState eval_old_index_state = AlgoOldIndexState::None;
+    std::chrono::duration<double> eval_old_index_build_duration{0}; // Part of eval_duration spent building the index
+    AlgoEvalAllocStats eval_alloc_stats; // Heap allocation behaviour during StartEval
+    std::string eval_preprocess; // Preprocessing pipeline the inputs went through, e.g. "gunzip+bcj-x86"
+    std::vector<AlgoPreprocessStage> eval_preprocess_stages; // Not part of eval_duration
+    AlgoEvalIoStats eval_io_stats; // Process I/O during StartEval
+    AlgoIoAccessSummary eval_old_read_access; // How the wrapper read the old input, when traced
+    AlgoInputProfile eval_input_profile; // Similarity and content of the inputs, when analyzed
+    AlgoEvalEnv eval_env; // Where and under which conditions the evaluation ran
 
 private:
+    std::string preset_old_md5; // See SetEvalInputHashes(), not copied
+    std::string preset_new_md5;
     std::mutex eval_mutex; // Mutex for thread safety
 };
 
@@ -289,7 +675,16 @@ class BaseAlgoWrapper
 protected:
     std::string old_file_path;
     std::string new_file_path;
+    std::string patch_file_path; // Empty means the wrapper picks a temporary location
+    AlgoEvalIoMode eval_io_mode = AlgoEvalIoMode::File;
+    AlgoEvalBuffer old_buffer; // Used in memory mode, owned by the caller
+    AlgoEvalBuffer new_buffer;
+    AlgoPatchSink patch_sink;
     AlgoEvalResult algo_eval_result;
+    ReadOffsetTrace* old_read_trace = nullptr; // Set by the runner while reads are traced
+    std::atomic<bool> cancel_requested{false};
+    std::atomic<uint64_t> progress_output_bytes{0};
+    std::atomic<uint64_t> progress_memory_bytes{0};
 public:
     BaseAlgoWrapper(/* args */) = default;
     virtual ~BaseAlgoWrapper() = default;
@@ -299,5 +694,164 @@ public:
     virtual int StartEval() = 0; // Start the evaluation process
     virtual int GetEvalResult(AlgoEvalResult &result) = 0; // Get the evaluation result
 
+    virtual int SetAlgoEvalPatchPath(const std::string& patch_file_path) // Set where the generated patch is written
+    {
+        this->patch_file_path = patch_file_path;
+        return 0; // Success
+    }
+    virtual int GetAlgoEvalPatchPath(std::string& patch_file_path) // Get where the generated patch is written
+    {
+        patch_file_path = this->patch_file_path;
+        return 0; // Success
+    }
+    // MD5 of the inputs of the next StartEval when the caller already has them, saves hashing them again
+    int SetAlgoEvalInputHashes(const std::string& old_file_md5, const std::string& new_file_md5)
+    {
+        return algo_eval_result.SetEvalInputHashes(old_file_md5, new_file_md5);
+    }
+
+    // In-memory evaluation: the buffers must stay valid until StartEval returns.
+    // Wrappers that only work on files keep this default.
+    virtual int SetAlgoEvalBuffer(const AlgoEvalBuffer& old_buffer, const AlgoEvalBuffer& new_buffer, AlgoPatchSink patch_sink)
+    {
+        (void)old_buffer;
+        (void)new_buffer;
+        (void)patch_sink;
+        return -1; // Not supported
+    }
+    virtual bool IsMemoryEvalSupported() const
+    {
+        return false;
+    }
+
+    // Apply a patch on the modeled device: all heap through env.heap, the old image
+    // and the patch through the flash readers, the new image to env.new_writer.
+    virtual int ApplyPatchConstrained(ConstrainedApplyEnv& env)
+    {
+        (void)env;
+        return -1; // Not supported
+    }
+    virtual bool IsConstrainedApplySupported() const
+    {
+        return false;
+    }
+
+    // Engines that preprocess the old file (suffix array, block hashes, ...) expose
+    // the structure here so it can be cached and reused for every target of one base.
+    // The tag names the engine and index format and must change with the layout.
+    virtual bool IsOldIndexSupported() const
+    {
+        return false;
+    }
+    virtual std::string GetOldIndexTag() const
+    {
+        return "";
+    }
+    virtual int BuildOldIndex(std::vector<uint8_t>& index) // From the current old file or buffer
+    {
+        (void)index;
+        return -1; // Not supported
+    }
+
+    // Wrappers that report their reads of the old input through traceOldRead()
+    // say so here, the runner then attaches a trace for the duration of StartEval.
+    virtual bool IsReadTraceSupported() const
+    {
+        return false;
+    }
+    int SetOldReadTrace(ReadOffsetTrace* trace) // Null stops tracing, the trace is owned by the caller
+    {
+        old_read_trace = trace;
+        return 0; // Success
+    }
+
+    // Wrappers that check IsCancelRequested() while they work say so here. A cancelled
+    // StartEval returns -1. The request stays set, a cancelled wrapper is not reused.
+    virtual bool IsCancelSupported() const
+    {
+        return false;
+    }
+    void RequestCancel() // Thread safe
+    {
+        cancel_requested = true;
+    }
+    bool IsCancelRequested() const
+    {
+        return cancel_requested.load();
+    }
+    void GetProgress(AlgoEvalProgress& progress) const // Thread safe
+    {
+        progress.output_bytes = progress_output_bytes.load();
+        progress.memory_bytes = progress_memory_bytes.load();
+    }
+
+protected:
+    // Called by wrappers while StartEval runs, so racing and monitoring see partial results
+    void reportProgress(uint64_t output_bytes, uint64_t memory_bytes)
+    {
+        progress_output_bytes = output_bytes;
+        progress_memory_bytes = memory_bytes;
+    }
+
+    // Called by wrappers for every read of the old file, or every region of the old buffer touched
+    void traceOldRead(uint64_t offset, uint64_t size)
+    {
+        if(old_read_trace != nullptr)
+        {
+            old_read_trace->Record(offset, size);
+        }
+    }
+
+    // Reads from the old file at offset and traces what was actually read.
+    // Returns the bytes read, 0 at the end of the file, -1 on error.
+    int64_t readOldFile(QFile& old_file, uint64_t offset, uint8_t* buffer, size_t size)
+    {
+        if(!old_file.seek(static_cast<qint64>(offset)))
+        {
+            return -1; // Failed to seek
+        }
+        qint64 got = old_file.read(reinterpret_cast<char*>(buffer), static_cast<qint64>(size));
+        if(got > 0)
+        {
+            traceOldRead(offset, static_cast<uint64_t>(got));
+        }
+        return got;
+    }
+
+    // Called from StartEval after the evaluation started and the input hashes are known.
+    // Looks the index up in the OldIndexCache, builds and stores it on a miss, and records
+    // on the result whether it was built or reused and how long building took.
+    int acquireOldIndex(std::shared_ptr<const OldIndex>& index)
+    {
+        if(!IsOldIndexSupported())
+        {
+            return -1; // Not supported
+        }
+        std::string old_file_md5, new_file_md5;
+        if(algo_eval_result.GetEvalInputHashes(old_file_md5, new_file_md5) != 0)
+        {
+            return -1; // Inputs are not set
+        }
+        OldIndexCache& cache = OldIndexCache::Instance();
+        index = cache.Find(GetOldIndexTag(), old_file_md5);
+        if(index)
+        {
+            algo_eval_result.SetEvalOldIndex(AlgoOldIndexState::Reused, std::chrono::duration<double>(0));
+            return 0; // Success
+        }
+
+        auto build_start = std::chrono::steady_clock::now();
+        std::vector<uint8_t> data;
+        if(BuildOldIndex(data) != 0)
+        {
+            return -1; // Failed to build the index
+        }
+        // Storing may write the index to the cache directory, which is not part of building it
+        std::chrono::duration<double> build_duration = std::chrono::steady_clock::now() - build_start;
+        index = cache.Store(GetOldIndexTag(), old_file_md5, std::move(data));
+        algo_eval_result.SetEvalOldIndex(AlgoOldIndexState::Built, build_duration);
+        return 0; // Success
+    }
+
 };
 #endif // BASE_ALGO_WRAPPER_H
@@ -0,0 +1,384 @@
+/*
+    Delta chain evaluation over an ordered sequence of versions
+
+    Devices in the field skip versions, so an update server either ships the
+    chain of consecutive patches (v1->v2->v3) or a direct patch (v1->v3). The
+    evaluator generates every consecutive and skip-level pair once, caching the
+    results by algorithm and input hashes, and compares the cumulative chain
+    cost with the direct patch for every pair that skips versions.
+*/
+#ifndef DELTA_CHAIN_H
+#define DELTA_CHAIN_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <sstream>
+#include <cstdint>
+
+#include <QFile>
+#include <QIODevice>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QCryptographicHash>
+
+#include "base_algo_wrapper.h"
+#include "algo_registry.h"
+#include "target_sim.h"
+
+struct DeltaEdgeResult
+{
+    std::string old_file_md5;
+    std::string new_file_md5;
+    uint64_t patch_size = 0; // Bytes
+    double generate_seconds = 0.0; // Patch generation on the host
+    bool apply_measured = false; // False when the wrapper cannot apply on the modeled device
+    bool apply_success = false; // The apply finished within the heap cap, see ApplySimResult::success
+    bool apply_hit_cap = false; // At least one allocation was refused during the apply
+    bool apply_verified = false; // Applied output matched the new version
+    double apply_seconds = 0.0; // Projected apply time on the modeled device
+};
+
+// Results keyed by (algorithm, old MD5, new MD5), shared across chains and runs.
+// Apply times depend on the device model, so a cache file keeps one section per
+// model. Only the section of the current model is loaded, the others are
+// written back unchanged.
+class DeltaResultCache
+{
+public:
+    DeltaResultCache() = default;
+    ~DeltaResultCache() = default;
+
+    static std::string MakeKey(const std::string& algo_name, const std::string& old_file_md5, const std::string& new_file_md5)
+    {
+        return algo_name + "|" + old_file_md5 + "|" + new_file_md5;
+    }
+
+    bool Find(const std::string& algo_name, const std::string& old_file_md5, const std::string& new_file_md5, DeltaEdgeResult& edge)
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex); // Lock the mutex for thread safety
+        auto it = entries.find(MakeKey(algo_name, old_file_md5, new_file_md5));
+        if(it == entries.end())
+        {
+            return false;
+        }
+        edge = it->second.edge;
+        return true;
+    }
+
+    void Store(const std::string& algo_name, const DeltaEdgeResult& edge)
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex); // Lock the mutex for thread safety
+        entries[MakeKey(algo_name, edge.old_file_md5, edge.new_file_md5)] = Entry{algo_name, edge};
+    }
+
+    // Format: {"version": 2, "devices": {"<tag>": [{"algo", "old_md5", "new_md5", ...}]}}
+    int SaveToFile(const std::string& file_path, const std::string& device_tag)
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex); // Lock the mutex for thread safety
+        QJsonArray result_array;
+        for(const auto& pair : entries)
+        {
+            const DeltaEdgeResult& edge = pair.second.edge;
+            QJsonObject result_obj;
+            result_obj["algo"] = QString::fromStdString(pair.second.algo_name);
+            result_obj["old_md5"] = QString::fromStdString(edge.old_file_md5);
+            result_obj["new_md5"] = QString::fromStdString(edge.new_file_md5);
+            result_obj["patch_size"] = static_cast<double>(edge.patch_size);
+            result_obj["generate_seconds"] = edge.generate_seconds;
+            result_obj["apply_measured"] = edge.apply_measured;
+            result_obj["apply_success"] = edge.apply_success;
+            result_obj["apply_hit_cap"] = edge.apply_hit_cap;
+            result_obj["apply_verified"] = edge.apply_verified;
+            result_obj["apply_seconds"] = edge.apply_seconds;
+            result_array.append(result_obj);
+        }
+        QJsonObject devices = other_devices;
+        devices[QString::fromStdString(device_tag)] = result_array;
+        QJsonObject root;
+        root["version"] = 2;
+        root["devices"] = devices;
+
+        QFile file(QString::fromStdString(file_path));
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            return -1; // Failed to open the file
+        }
+        if(file.write(QJsonDocument(root).toJson()) < 0)
+        {
+            return -1; // Failed to write the file
+        }
+        return 0; // Success
+    }
+
+    // Loads the section of device_tag and keeps the other sections for SaveToFile().
+    // Version 1 files hold a single device section.
+    int LoadFromFile(const std::string& file_path, const std::string& device_tag)
+    {
+        QFile file(QString::fromStdString(file_path));
+        if(!file.open(QIODevice::ReadOnly))
+        {
+            return -1; // Failed to open the file
+        }
+        QJsonParseError parse_error;
+        QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parse_error);
+        if(parse_error.error != QJsonParseError::NoError || !doc.isObject())
+        {
+            return -1; // Malformed file
+        }
+        QJsonObject root = doc.object();
+        QJsonObject devices;
+        int version = root.value("version").toInt();
+        if(version == 1)
+        {
+            devices[root.value("device").toString()] = root.value("results").toArray();
+        }
+        else if(version == 2)
+        {
+            devices = root.value("devices").toObject();
+        }
+        else
+        {
+            return -1; // Unsupported version
+        }
+
+        std::map<std::string, Entry> loaded;
+        QJsonObject others;
+        for(const QString& tag : devices.keys())
+        {
+            if(tag.toStdString() != device_tag)
+            {
+                others[tag] = devices.value(tag);
+                continue;
+            }
+            for(const QJsonValue& result_value : devices.value(tag).toArray())
+            {
+                QJsonObject result_obj = result_value.toObject();
+                Entry entry;
+                entry.algo_name = result_obj.value("algo").toString().toStdString();
+                entry.edge.old_file_md5 = result_obj.value("old_md5").toString().toStdString();
+                entry.edge.new_file_md5 = result_obj.value("new_md5").toString().toStdString();
+                entry.edge.patch_size = static_cast<uint64_t>(result_obj.value("patch_size").toDouble());
+                entry.edge.generate_seconds = result_obj.value("generate_seconds").toDouble();
+                entry.edge.apply_measured = result_obj.value("apply_measured").toBool();
+                entry.edge.apply_verified = result_obj.value("apply_verified").toBool();
+                // Older files did not record success, a verified apply is the only one known to have finished
+                entry.edge.apply_success = result_obj.value("apply_success").toBool(entry.edge.apply_verified);
+                entry.edge.apply_hit_cap = result_obj.value("apply_hit_cap").toBool();
+                entry.edge.apply_seconds = result_obj.value("apply_seconds").toDouble();
+                if(entry.algo_name.empty() || entry.edge.old_file_md5.empty() || entry.edge.new_file_md5.empty())
+                {
+                    return -1; // Incomplete result
+                }
+                loaded[MakeKey(entry.algo_name, entry.edge.old_file_md5, entry.edge.new_file_md5)] = entry;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(cache_mutex); // Lock the mutex for thread safety
+        entries = std::move(loaded);
+        other_devices = others;
+        return 0; // Success
+    }
+
+private:
+    struct Entry
+    {
+        std::string algo_name;
+        DeltaEdgeResult edge;
+    };
+
+    std::map<std::string, Entry> entries; // Results of the current device model
+    QJsonObject other_devices; // Sections of the other device models, tag -> results
+    std::mutex cache_mutex; // Mutex for thread safety
+};
+
+// Chained versus direct delivery from version `from` to version `to`
+struct DeltaChainComparison
+{
+    size_t from = 0; // Indexes into the version list
+    size_t to = 0;
+    DeltaEdgeResult direct;
+    uint64_t chain_patch_size = 0; // Sum over the consecutive patches from..to
+    double chain_apply_seconds = 0.0; // Only meaningful when chain_apply_verified
+    bool chain_apply_measured = false; // Every hop of the chain has an apply time
+    bool chain_apply_success = false; // Every hop finished within the heap cap
+    bool chain_apply_verified = false; // Every hop also produced the expected output
+};
+
+struct DeltaChainReport
+{
+    std::string algo_name;
+    std::vector<std::string> version_md5s;
+    std::map<std::pair<size_t, size_t>, DeltaEdgeResult> edges; // (from, to) -> result
+    int cached_edges = 0;
+    int generated_edges = 0;
+    std::vector<DeltaChainComparison> comparisons; // Only pairs that skip at least one version
+};
+
+class DeltaChainEvaluator
+{
+public:
+    DeltaChainEvaluator(const TargetDeviceModel& model, DeltaResultCache& cache) : model(model), result_cache(cache) {}
+    ~DeltaChainEvaluator() = default;
+
+    static std::string MakeDeviceTag(const TargetDeviceModel& model)
+    {
+        std::ostringstream tag;
+        tag << model.heap_cap << "/" << model.flash_read_bandwidth << "/" << model.write_bandwidth << "/"
+            << model.read_chunk_size << "/" << model.flash_read_latency << "/" << model.cpu_scale;
+        return tag.str();
+    }
+
+    // Evaluates every pair (i, j), i < j, with j - i <= max_skip (0 for no limit).
+    // patch_file_path is scratch space for the generated patches.
+    int Evaluate(const std::string& algo_name,
+                 const AlgoWrapperFactory& factory,
+                 const std::vector<std::string>& version_paths,
+                 size_t max_skip,
+                 const std::string& patch_file_path,
+                 DeltaChainReport& report)
+    {
+        report = DeltaChainReport();
+        report.algo_name = algo_name;
+        if(!factory || version_paths.size() < 2)
+        {
+            return -1; // Nothing to evaluate
+        }
+        for(const auto& version_path : version_paths)
+        {
+            std::string md5;
+            if(fileMD5(version_path, md5) != 0)
+            {
+                return -1; // Version not readable
+            }
+            report.version_md5s.push_back(md5);
+        }
+
+        for(size_t from = 0; from + 1 < version_paths.size(); from++)
+        {
+            for(size_t to = from + 1; to < version_paths.size(); to++)
+            {
+                if(max_skip != 0 && to - from > max_skip)
+                {
+                    break;
+                }
+                DeltaEdgeResult edge;
+                if(result_cache.Find(algo_name, report.version_md5s[from], report.version_md5s[to], edge))
+                {
+                    report.cached_edges++;
+                }
+                else
+                {
+                    if(evaluateEdge(factory, version_paths[from], version_paths[to], patch_file_path, edge) != 0)
+                    {
+                        return -1; // Generation failed
+                    }
+                    result_cache.Store(algo_name, edge);
+                    report.generated_edges++;
+                }
+                report.edges[{from, to}] = edge;
+            }
+        }
+
+        for(const auto& pair : report.edges)
+        {
+            size_t from = pair.first.first;
+            size_t to = pair.first.second;
+            if(to - from < 2)
+            {
+                continue; // Consecutive pairs are the chain itself
+            }
+            DeltaChainComparison comparison;
+            comparison.from = from;
+            comparison.to = to;
+            comparison.direct = pair.second;
+            comparison.chain_apply_measured = true;
+            comparison.chain_apply_success = true;
+            comparison.chain_apply_verified = true;
+            for(size_t hop = from; hop < to; hop++)
+            {
+                const DeltaEdgeResult& hop_edge = report.edges.at({hop, hop + 1});
+                comparison.chain_patch_size += hop_edge.patch_size;
+                comparison.chain_apply_measured = comparison.chain_apply_measured && hop_edge.apply_measured;
+                comparison.chain_apply_success = comparison.chain_apply_success && hop_edge.apply_success;
+                comparison.chain_apply_verified = comparison.chain_apply_verified && hop_edge.apply_verified;
+            }
+            // An apply that produced the wrong output has no meaningful time
+            if(comparison.chain_apply_measured && comparison.chain_apply_verified)
+            {
+                for(size_t hop = from; hop < to; hop++)
+                {
+                    comparison.chain_apply_seconds += report.edges.at({hop, hop + 1}).apply_seconds;
+                }
+            }
+            report.comparisons.push_back(comparison);
+        }
+        return 0; // Success
+    }
+
+private:
+    int evaluateEdge(const AlgoWrapperFactory& factory,
+                     const std::string& old_file_path,
+                     const std::string& new_file_path,
+                     const std::string& patch_file_path,
+                     DeltaEdgeResult& edge)
+    {
+        auto wrapper = factory();
+        AlgoEvalResult result;
+        std::string unused_path;
+        std::chrono::duration<double> duration;
+        uint64_t memory = 0, cpu = 0;
+        edge = DeltaEdgeResult();
+        if(!wrapper
+            || wrapper->SetAlgoEvalFilePath(old_file_path, new_file_path) != 0
+            || wrapper->SetAlgoEvalPatchPath(patch_file_path) != 0
+            || wrapper->StartEval() != 0
+            || wrapper->GetEvalResult(result) != 0
+            || result.GetEvalResult(unused_path, unused_path, edge.old_file_md5, edge.new_file_md5, duration, memory, cpu) != 0
+            || result.GetEvalPatchSize(edge.patch_size) != 0)
+        {
+            return -1; // Generation failed
+        }
+        edge.generate_seconds = duration.count();
+
+        if(wrapper->IsConstrainedApplySupported())
+        {
+            ConstrainedApplySimulator simulator(model);
+            ApplySimResult apply;
+            if(simulator.Run(factory, old_file_path, patch_file_path, edge.new_file_md5, model.heap_cap, apply) != 0)
+            {
+                return -1; // Simulation could not run
+            }
+            edge.apply_measured = true;
+            edge.apply_success = apply.success;
+            edge.apply_hit_cap = apply.hit_cap;
+            edge.apply_verified = apply.output_verified;
+            edge.apply_seconds = apply.projected_seconds;
+        }
+        return 0; // Success
+    }
+
+    static int fileMD5(const std::string& file_path, std::string& md5_hash)
+    {
+        QFile file(QString::fromStdString(file_path));
+        if(!file.open(QIODevice::ReadOnly))
+        {
+            return -1; // Failed to open the file
+        }
+        QCryptographicHash md5(QCryptographicHash::Md5);
+        if(!md5.addData(&file))
+        {
+            return -1; // Failed to read the file
+        }
+        md5_hash = md5.result().toHex().toStdString();
+        return 0; // Success
+    }
+
+    TargetDeviceModel model;
+    DeltaResultCache& result_cache;
+};
+
+#endif // DELTA_CHAIN_H
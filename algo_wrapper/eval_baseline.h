@@ -0,0 +1,610 @@
+/*
+    Stored evaluation baselines and the regression gate comparing against them
+*/
+#ifndef EVAL_BASELINE_H
+#define EVAL_BASELINE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <cstdint>
+
+#include <QFile>
+#include <QIODevice>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonValue>
+
+#include "base_algo_wrapper.h"
+#include "eval_stats.h"
+
+struct EvalSample
+{
+    double duration = 0.0; // Evaluation duration in seconds
+    uint64_t memory = 0; // Memory usage in bytes
+    uint64_t cpu = 0; // CPU occupancy in percent
+    uint64_t patch_size = 0; // Generated patch size in bytes
+    std::string cpu_model; // Execution environment, see AlgoEvalEnv
+    std::string cpu_governor;
+    double cpu_freq_mhz = 0.0;
+    double load_avg = -1.0;
+    double other_load = -1.0; // load_avg without the evaluating process's own share
+    int env_warnings = 0; // Number of noisy conditions detected while measuring
+    std::string old_index; // "none", "built" or "reused", see AlgoOldIndexState
+    double old_index_build_duration = 0.0; // Seconds of duration spent building the old file index
+    AlgoEvalAllocStats alloc_stats; // Only filled when the run was profiled
+    std::vector<AlgoPreprocessStage> preprocess_stages; // Cost of each preprocessing stage, not part of duration
+    AlgoEvalIoStats io_stats; // Only filled when the run was profiled
+    AlgoIoAccessSummary old_read_access; // Only filled when the old input reads were traced
+    AlgoInputProfile input_profile; // Only filled when the pair was analyzed
+};
+
+struct EvalCase
+{
+    std::string algo_name;
+    std::string io_mode; // "file" or "memory", see AlgoEvalResult::GetEvalIoModeName()
+    std::string preprocess; // Preprocessing pipeline, empty for raw inputs; the hashes are of the preprocessed inputs
+    bool index_cache = false; // The old index came from the OldIndexCache, the first sample built it and the rest reused it
+    std::string old_file_md5;
+    std::string new_file_md5;
+    std::string old_file_path; // Informational only, cases are matched by hash
+    std::string new_file_path;
+    std::vector<EvalSample> samples;
+};
+
+class EvalBaseline
+{
+public:
+    EvalBaseline() = default;
+    ~EvalBaseline() = default;
+
+    // Cached and uncached runs measure different costs, so the cache mode is part of the key
+    static std::string MakeCaseKey(const std::string& algo_name,
+                                   const std::string& io_mode,
+                                   const std::string& preprocess,
+                                   bool index_cache,
+                                   const std::string& old_file_md5,
+                                   const std::string& new_file_md5)
+    {
+        return algo_name + "|" + io_mode + "|" + preprocess + "|" + (index_cache ? "index-cache" : "") + "|" + old_file_md5 + "|" + new_file_md5;
+    }
+
+    int AddResult(const std::string& algo_name, AlgoEvalResult& result)
+    {
+        std::string old_file_path, new_file_path, old_file_md5, new_file_md5;
+        std::chrono::duration<double> duration;
+        EvalSample sample;
+
+        if(result.GetEvalResult(old_file_path, new_file_path, old_file_md5, new_file_md5,
+                                duration, sample.memory, sample.cpu) != 0)
+        {
+            return -1; // Evaluation not finished
+        }
+        if(result.GetEvalPatchSize(sample.patch_size) != 0)
+        {
+            return -1; // Evaluation not finished
+        }
+        sample.duration = duration.count();
+        AlgoEvalEnv env;
+        result.GetEvalEnv(env);
+        sample.cpu_model = env.cpu_model;
+        sample.cpu_governor = env.cpu_governor;
+        sample.cpu_freq_mhz = env.cpu_freq_mhz;
+        sample.load_avg = env.load_avg;
+        sample.other_load = env.other_load;
+        sample.env_warnings = static_cast<int>(env.warnings.size());
+        AlgoOldIndexState index_state = AlgoOldIndexState::None;
+        std::chrono::duration<double> build_duration, incremental_duration;
+        if(result.GetEvalOldIndex(index_state, build_duration, incremental_duration) != 0)
+        {
+            return -1; // Evaluation not finished
+        }
+        sample.old_index = AlgoEvalResult::GetOldIndexStateName(index_state);
+        sample.old_index_build_duration = build_duration.count();
+        result.GetEvalAllocStats(sample.alloc_stats);
+        result.GetEvalIoStats(sample.io_stats);
+        result.GetEvalOldReadAccess(sample.old_read_access);
+        result.GetEvalInputProfile(sample.input_profile);
+        std::string preprocess;
+        result.GetEvalPreprocess(preprocess, sample.preprocess_stages);
+        std::string io_mode = AlgoEvalResult::GetEvalIoModeName(result.GetEvalIoMode());
+
+        bool index_cache = index_state != AlgoOldIndexState::None;
+        EvalCase& eval_case = cases[MakeCaseKey(algo_name, io_mode, preprocess, index_cache, old_file_md5, new_file_md5)];
+        eval_case.algo_name = algo_name;
+        eval_case.io_mode = io_mode;
+        eval_case.preprocess = preprocess;
+        eval_case.index_cache = index_cache;
+        eval_case.old_file_md5 = old_file_md5;
+        eval_case.new_file_md5 = new_file_md5;
+        eval_case.old_file_path = old_file_path;
+        eval_case.new_file_path = new_file_path;
+        eval_case.samples.push_back(sample);
+        return 0; // Success
+    }
+
+    // Records a case the scheduler chose not to run, so the gate does not count it as missing.
+    // A skipped case has no cache mode, IsSkipped() matches it in either.
+    void AddSkipped(const std::string& algo_name,
+                    const std::string& io_mode,
+                    const std::string& preprocess,
+                    const std::string& old_file_md5,
+                    const std::string& new_file_md5)
+    {
+        skipped_cases.insert(MakeCaseKey(algo_name, io_mode, preprocess, false, old_file_md5, new_file_md5));
+    }
+
+    bool IsSkipped(const EvalCase& eval_case) const
+    {
+        return skipped_cases.count(MakeCaseKey(eval_case.algo_name, eval_case.io_mode, eval_case.preprocess, false,
+                                               eval_case.old_file_md5, eval_case.new_file_md5)) != 0;
+    }
+
+    const std::map<std::string, EvalCase>& GetCases() const
+    {
+        return cases;
+    }
+
+    void Clear()
+    {
+        cases.clear();
+        skipped_cases.clear();
+    }
+
+    int SaveToFile(const std::string& file_path) const
+    {
+        QJsonArray case_array;
+        for(const auto& pair : cases)
+        {
+            const EvalCase& eval_case = pair.second;
+            QJsonArray sample_array;
+            for(const auto& sample : eval_case.samples)
+            {
+                QJsonObject sample_obj;
+                sample_obj["duration"] = sample.duration;
+                sample_obj["memory"] = static_cast<double>(sample.memory);
+                sample_obj["cpu"] = static_cast<double>(sample.cpu);
+                sample_obj["patch_size"] = static_cast<double>(sample.patch_size);
+                sample_obj["cpu_model"] = QString::fromStdString(sample.cpu_model);
+                sample_obj["cpu_governor"] = QString::fromStdString(sample.cpu_governor);
+                sample_obj["cpu_freq_mhz"] = sample.cpu_freq_mhz;
+                sample_obj["load_avg"] = sample.load_avg;
+                sample_obj["other_load"] = sample.other_load;
+                sample_obj["env_warnings"] = sample.env_warnings;
+                sample_obj["old_index"] = QString::fromStdString(sample.old_index);
+                sample_obj["old_index_build_duration"] = sample.old_index_build_duration;
+                if(sample.alloc_stats.profiled)
+                {
+                    QJsonArray size_class_array;
+                    for(uint64_t count : sample.alloc_stats.size_classes)
+                    {
+                        size_class_array.append(static_cast<double>(count));
+                    }
+                    QJsonObject alloc_obj;
+                    alloc_obj["allocations"] = static_cast<double>(sample.alloc_stats.allocations);
+                    alloc_obj["frees"] = static_cast<double>(sample.alloc_stats.frees);
+                    alloc_obj["bytes_allocated"] = static_cast<double>(sample.alloc_stats.bytes_allocated);
+                    alloc_obj["bytes_freed"] = static_cast<double>(sample.alloc_stats.bytes_freed);
+                    alloc_obj["peak_live_bytes"] = static_cast<double>(sample.alloc_stats.peak_live_bytes);
+                    alloc_obj["malloc_tracked"] = sample.alloc_stats.malloc_tracked;
+                    alloc_obj["overhead_seconds"] = sample.alloc_stats.overhead_seconds;
+                    alloc_obj["size_classes"] = size_class_array;
+                    sample_obj["alloc"] = alloc_obj;
+                }
+                if(!sample.preprocess_stages.empty())
+                {
+                    QJsonArray stage_array;
+                    for(const auto& stage : sample.preprocess_stages)
+                    {
+                        QJsonObject stage_obj;
+                        stage_obj["name"] = QString::fromStdString(stage.name);
+                        stage_obj["seconds"] = stage.seconds;
+                        stage_obj["peak_memory"] = static_cast<double>(stage.peak_memory);
+                        stage_obj["memory_measured"] = stage.memory_measured;
+                        stage_obj["input_bytes"] = static_cast<double>(stage.input_bytes);
+                        stage_obj["output_bytes"] = static_cast<double>(stage.output_bytes);
+                        stage_array.append(stage_obj);
+                    }
+                    sample_obj["preprocess_stages"] = stage_array;
+                }
+                if(sample.io_stats.profiled)
+                {
+                    QJsonObject io_obj;
+                    io_obj["rchar"] = static_cast<double>(sample.io_stats.rchar);
+                    io_obj["wchar"] = static_cast<double>(sample.io_stats.wchar);
+                    io_obj["syscr"] = static_cast<double>(sample.io_stats.syscr);
+                    io_obj["syscw"] = static_cast<double>(sample.io_stats.syscw);
+                    io_obj["read_bytes"] = static_cast<double>(sample.io_stats.read_bytes);
+                    io_obj["write_bytes"] = static_cast<double>(sample.io_stats.write_bytes);
+                    sample_obj["io"] = io_obj;
+                }
+                if(sample.old_read_access.traced)
+                {
+                    QJsonArray seek_class_array;
+                    for(uint64_t count : sample.old_read_access.seek_classes)
+                    {
+                        seek_class_array.append(static_cast<double>(count));
+                    }
+                    QJsonObject access_obj;
+                    access_obj["reads"] = static_cast<double>(sample.old_read_access.reads);
+                    access_obj["bytes_read"] = static_cast<double>(sample.old_read_access.bytes_read);
+                    access_obj["sequential_reads"] = static_cast<double>(sample.old_read_access.sequential_reads);
+                    access_obj["random_reads"] = static_cast<double>(sample.old_read_access.random_reads);
+                    access_obj["seek_classes"] = seek_class_array;
+                    access_obj["working_set_bytes"] = static_cast<double>(sample.old_read_access.working_set_bytes);
+                    access_obj["dropped_reads"] = static_cast<double>(sample.old_read_access.dropped_reads);
+                    sample_obj["old_read_access"] = access_obj;
+                }
+                if(sample.input_profile.analyzed)
+                {
+                    QJsonObject profile_obj;
+                    profile_obj["similarity"] = sample.input_profile.similarity;
+                    profile_obj["old_entropy"] = sample.input_profile.old_entropy;
+                    profile_obj["new_entropy"] = sample.input_profile.new_entropy;
+                    profile_obj["new_high_entropy_ratio"] = sample.input_profile.new_high_entropy_ratio;
+                    profile_obj["old_kind"] = QString::fromLatin1(AlgoInputProfile::GetContentKindName(sample.input_profile.old_kind));
+                    profile_obj["new_kind"] = QString::fromLatin1(AlgoInputProfile::GetContentKindName(sample.input_profile.new_kind));
+                    profile_obj["old_size"] = static_cast<double>(sample.input_profile.old_size);
+                    profile_obj["new_size"] = static_cast<double>(sample.input_profile.new_size);
+                    profile_obj["seconds"] = sample.input_profile.seconds;
+                    sample_obj["input_profile"] = profile_obj;
+                }
+                sample_array.append(sample_obj);
+            }
+            QJsonObject case_obj;
+            case_obj["algo"] = QString::fromStdString(eval_case.algo_name);
+            case_obj["io_mode"] = QString::fromStdString(eval_case.io_mode);
+            case_obj["preprocess"] = QString::fromStdString(eval_case.preprocess);
+            case_obj["index_cache"] = eval_case.index_cache;
+            case_obj["old_md5"] = QString::fromStdString(eval_case.old_file_md5);
+            case_obj["new_md5"] = QString::fromStdString(eval_case.new_file_md5);
+            case_obj["old_file"] = QString::fromStdString(eval_case.old_file_path);
+            case_obj["new_file"] = QString::fromStdString(eval_case.new_file_path);
+            case_obj["samples"] = sample_array;
+            case_array.append(case_obj);
+        }
+        QJsonObject root;
+        root["version"] = 1;
+        root["cases"] = case_array;
+
+        QFile file(QString::fromStdString(file_path));
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            return -1; // Failed to open the file
+        }
+        if(file.write(QJsonDocument(root).toJson()) < 0)
+        {
+            return -1; // Failed to write the file
+        }
+        return 0; // Success
+    }
+
+    int LoadFromFile(const std::string& file_path)
+    {
+        QFile file(QString::fromStdString(file_path));
+        if(!file.open(QIODevice::ReadOnly))
+        {
+            return -1; // Failed to open the file
+        }
+        QJsonParseError parse_error;
+        QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parse_error);
+        if(parse_error.error != QJsonParseError::NoError || !doc.isObject())
+        {
+            return -1; // Malformed baseline
+        }
+
+        std::map<std::string, EvalCase> loaded;
+        const QJsonArray case_array = doc.object().value("cases").toArray();
+        for(const QJsonValue& case_value : case_array)
+        {
+            QJsonObject case_obj = case_value.toObject();
+            EvalCase eval_case;
+            eval_case.algo_name = case_obj.value("algo").toString().toStdString();
+            eval_case.io_mode = case_obj.value("io_mode").toString("file").toStdString();
+            eval_case.preprocess = case_obj.value("preprocess").toString().toStdString();
+            eval_case.index_cache = case_obj.value("index_cache").toBool();
+            eval_case.old_file_md5 = case_obj.value("old_md5").toString().toStdString();
+            eval_case.new_file_md5 = case_obj.value("new_md5").toString().toStdString();
+            eval_case.old_file_path = case_obj.value("old_file").toString().toStdString();
+            eval_case.new_file_path = case_obj.value("new_file").toString().toStdString();
+            if(eval_case.algo_name.empty() || eval_case.old_file_md5.empty() || eval_case.new_file_md5.empty())
+            {
+                return -1; // Incomplete case
+            }
+            const QJsonArray sample_array = case_obj.value("samples").toArray();
+            for(const QJsonValue& sample_value : sample_array)
+            {
+                QJsonObject sample_obj = sample_value.toObject();
+                EvalSample sample;
+                sample.duration = sample_obj.value("duration").toDouble();
+                sample.memory = static_cast<uint64_t>(sample_obj.value("memory").toDouble());
+                sample.cpu = static_cast<uint64_t>(sample_obj.value("cpu").toDouble());
+                sample.patch_size = static_cast<uint64_t>(sample_obj.value("patch_size").toDouble());
+                sample.cpu_model = sample_obj.value("cpu_model").toString().toStdString();
+                sample.cpu_governor = sample_obj.value("cpu_governor").toString().toStdString();
+                sample.cpu_freq_mhz = sample_obj.value("cpu_freq_mhz").toDouble();
+                sample.load_avg = sample_obj.value("load_avg").toDouble(-1.0);
+                sample.other_load = sample_obj.value("other_load").toDouble(-1.0);
+                sample.env_warnings = sample_obj.value("env_warnings").toInt();
+                sample.old_index = sample_obj.value("old_index").toString("none").toStdString();
+                sample.old_index_build_duration = sample_obj.value("old_index_build_duration").toDouble();
+                if(sample_obj.contains("alloc"))
+                {
+                    QJsonObject alloc_obj = sample_obj.value("alloc").toObject();
+                    sample.alloc_stats.profiled = true;
+                    sample.alloc_stats.allocations = static_cast<uint64_t>(alloc_obj.value("allocations").toDouble());
+                    sample.alloc_stats.frees = static_cast<uint64_t>(alloc_obj.value("frees").toDouble());
+                    sample.alloc_stats.bytes_allocated = static_cast<uint64_t>(alloc_obj.value("bytes_allocated").toDouble());
+                    sample.alloc_stats.bytes_freed = static_cast<uint64_t>(alloc_obj.value("bytes_freed").toDouble());
+                    sample.alloc_stats.peak_live_bytes = static_cast<uint64_t>(alloc_obj.value("peak_live_bytes").toDouble());
+                    sample.alloc_stats.malloc_tracked = alloc_obj.value("malloc_tracked").toBool();
+                    sample.alloc_stats.overhead_seconds = alloc_obj.value("overhead_seconds").toDouble();
+                    QJsonArray size_class_array = alloc_obj.value("size_classes").toArray();
+                    for(int size_class = 0; size_class < AlgoEvalAllocStats::SizeClassCount && size_class < size_class_array.size(); size_class++)
+                    {
+                        sample.alloc_stats.size_classes[size_class] = static_cast<uint64_t>(size_class_array.at(size_class).toDouble());
+                    }
+                }
+                for(const QJsonValue& stage_value : sample_obj.value("preprocess_stages").toArray())
+                {
+                    QJsonObject stage_obj = stage_value.toObject();
+                    AlgoPreprocessStage stage;
+                    stage.name = stage_obj.value("name").toString().toStdString();
+                    stage.seconds = stage_obj.value("seconds").toDouble();
+                    stage.peak_memory = static_cast<uint64_t>(stage_obj.value("peak_memory").toDouble());
+                    stage.memory_measured = stage_obj.value("memory_measured").toBool(stage.peak_memory > 0);
+                    stage.input_bytes = static_cast<uint64_t>(stage_obj.value("input_bytes").toDouble());
+                    stage.output_bytes = static_cast<uint64_t>(stage_obj.value("output_bytes").toDouble());
+                    sample.preprocess_stages.push_back(stage);
+                }
+                if(sample_obj.contains("io"))
+                {
+                    QJsonObject io_obj = sample_obj.value("io").toObject();
+                    sample.io_stats.profiled = true;
+                    sample.io_stats.rchar = static_cast<uint64_t>(io_obj.value("rchar").toDouble());
+                    sample.io_stats.wchar = static_cast<uint64_t>(io_obj.value("wchar").toDouble());
+                    sample.io_stats.syscr = static_cast<uint64_t>(io_obj.value("syscr").toDouble());
+                    sample.io_stats.syscw = static_cast<uint64_t>(io_obj.value("syscw").toDouble());
+                    sample.io_stats.read_bytes = static_cast<uint64_t>(io_obj.value("read_bytes").toDouble());
+                    sample.io_stats.write_bytes = static_cast<uint64_t>(io_obj.value("write_bytes").toDouble());
+                }
+                if(sample_obj.contains("old_read_access"))
+                {
+                    QJsonObject access_obj = sample_obj.value("old_read_access").toObject();
+                    sample.old_read_access.traced = true;
+                    sample.old_read_access.reads = static_cast<uint64_t>(access_obj.value("reads").toDouble());
+                    sample.old_read_access.bytes_read = static_cast<uint64_t>(access_obj.value("bytes_read").toDouble());
+                    sample.old_read_access.sequential_reads = static_cast<uint64_t>(access_obj.value("sequential_reads").toDouble());
+                    sample.old_read_access.random_reads = static_cast<uint64_t>(access_obj.value("random_reads").toDouble());
+                    QJsonArray seek_class_array = access_obj.value("seek_classes").toArray();
+                    for(int seek_class = 0; seek_class < AlgoIoAccessSummary::SeekClassCount && seek_class < seek_class_array.size(); seek_class++)
+                    {
+                        sample.old_read_access.seek_classes[seek_class] = static_cast<uint64_t>(seek_class_array.at(seek_class).toDouble());
+                    }
+                    sample.old_read_access.working_set_bytes = static_cast<uint64_t>(access_obj.value("working_set_bytes").toDouble());
+                    sample.old_read_access.dropped_reads = static_cast<uint64_t>(access_obj.value("dropped_reads").toDouble());
+                }
+                if(sample_obj.contains("input_profile"))
+                {
+                    QJsonObject profile_obj = sample_obj.value("input_profile").toObject();
+                    sample.input_profile.analyzed = true;
+                    sample.input_profile.similarity = profile_obj.value("similarity").toDouble();
+                    sample.input_profile.old_entropy = profile_obj.value("old_entropy").toDouble();
+                    sample.input_profile.new_entropy = profile_obj.value("new_entropy").toDouble();
+                    sample.input_profile.new_high_entropy_ratio = profile_obj.value("new_high_entropy_ratio").toDouble();
+                    sample.input_profile.old_kind = AlgoInputProfile::ParseContentKind(profile_obj.value("old_kind").toString().toStdString());
+                    sample.input_profile.new_kind = AlgoInputProfile::ParseContentKind(profile_obj.value("new_kind").toString().toStdString());
+                    sample.input_profile.old_size = static_cast<uint64_t>(profile_obj.value("old_size").toDouble());
+                    sample.input_profile.new_size = static_cast<uint64_t>(profile_obj.value("new_size").toDouble());
+                    sample.input_profile.seconds = profile_obj.value("seconds").toDouble();
+                }
+                eval_case.samples.push_back(sample);
+            }
+            loaded[MakeCaseKey(eval_case.algo_name, eval_case.io_mode, eval_case.preprocess, eval_case.index_cache,
+                               eval_case.old_file_md5, eval_case.new_file_md5)] = eval_case;
+        }
+        cases = std::move(loaded);
+        return 0; // Success
+    }
+
+private:
+    std::map<std::string, EvalCase> cases; // Keyed by MakeCaseKey()
+    std::set<std::string> skipped_cases; // Keys of cases skipped by the scheduler, without cache mode, not saved
+};
+
+struct RegressionThresholds
+{
+    double duration = 0.20; // Relative slowdown tolerated before flagging
+    double memory = 0.10; // Relative memory growth tolerated before flagging
+    double patch_size = 0.05; // Relative patch size growth tolerated before flagging
+    double alpha = 0.05; // Significance level of the Welch t-test
+};
+
+enum class MetricChange
+{
+    Unchanged,
+    Improved,
+    Regressed
+};
+
+struct MetricComparison
+{
+    std::string metric;
+    double baseline_mean = 0.0;
+    double current_mean = 0.0;
+    double relative_change = 0.0; // (current - baseline) / baseline
+    double p_value = 1.0;
+    MetricChange change = MetricChange::Unchanged;
+};
+
+struct CaseComparison
+{
+    std::string algo_name;
+    std::string io_mode;
+    std::string preprocess;
+    bool index_cache = false;
+    std::string old_file_md5;
+    std::string new_file_md5;
+    bool in_baseline = false; // False for cases that have no baseline to compare against
+    bool in_current = true; // False for baseline cases the current run did not produce
+    bool skipped = false; // Not produced because the scheduler skipped it, not counted as missing
+    bool cpu_model_changed = false; // Baseline was recorded on a different CPU
+    int noisy_samples = 0; // Current samples measured under noisy conditions
+    std::vector<MetricComparison> metrics;
+};
+
+class RegressionGate
+{
+public:
+    explicit RegressionGate(const RegressionThresholds& thresholds) : thresholds(thresholds) {}
+    ~RegressionGate() = default;
+
+    int Compare(const EvalBaseline& baseline, const EvalBaseline& current, std::vector<CaseComparison>& comparisons) const
+    {
+        comparisons.clear();
+        for(const auto& pair : current.GetCases())
+        {
+            const EvalCase& current_case = pair.second;
+            CaseComparison comparison;
+            comparison.algo_name = current_case.algo_name;
+            comparison.io_mode = current_case.io_mode;
+            comparison.preprocess = current_case.preprocess;
+            comparison.index_cache = current_case.index_cache;
+            for(const auto& sample : current_case.samples)
+            {
+                comparison.noisy_samples += (sample.env_warnings > 0) ? 1 : 0;
+            }
+            comparison.old_file_md5 = current_case.old_file_md5;
+            comparison.new_file_md5 = current_case.new_file_md5;
+
+            auto it = baseline.GetCases().find(pair.first);
+            if(it != baseline.GetCases().end() && !it->second.samples.empty() && !current_case.samples.empty())
+            {
+                const EvalCase& baseline_case = it->second;
+                comparison.in_baseline = true;
+                comparison.cpu_model_changed = baseline_case.samples.front().cpu_model != current_case.samples.front().cpu_model;
+                if(current_case.index_cache)
+                {
+                    // Samples that built the index and samples that reused it differ by the build,
+                    // and how many of each a run has depends on the cache, so only the per-target cost is compared
+                    comparison.metrics.push_back(compareMetric("incremental", thresholds.duration,
+                        collectIncremental(baseline_case), collectIncremental(current_case)));
+                }
+                else
+                {
+                    comparison.metrics.push_back(compareMetric("duration", thresholds.duration,
+                        collect(baseline_case, &EvalSample::duration), collect(current_case, &EvalSample::duration)));
+                }
+                comparison.metrics.push_back(compareMetric("memory", thresholds.memory,
+                    collect(baseline_case, &EvalSample::memory), collect(current_case, &EvalSample::memory)));
+                comparison.metrics.push_back(compareMetric("patch_size", thresholds.patch_size,
+                    collect(baseline_case, &EvalSample::patch_size), collect(current_case, &EvalSample::patch_size)));
+            }
+            comparisons.push_back(comparison);
+        }
+
+        // A dropped algorithm, pipeline or pair must not pass the gate unnoticed
+        for(const auto& pair : baseline.GetCases())
+        {
+            if(current.GetCases().count(pair.first) != 0)
+            {
+                continue;
+            }
+            const EvalCase& baseline_case = pair.second;
+            CaseComparison comparison;
+            comparison.algo_name = baseline_case.algo_name;
+            comparison.io_mode = baseline_case.io_mode;
+            comparison.preprocess = baseline_case.preprocess;
+            comparison.index_cache = baseline_case.index_cache;
+            comparison.old_file_md5 = baseline_case.old_file_md5;
+            comparison.new_file_md5 = baseline_case.new_file_md5;
+            comparison.in_baseline = true;
+            comparison.in_current = false;
+            comparison.skipped = current.IsSkipped(baseline_case);
+            comparisons.push_back(comparison);
+        }
+        return 0; // Success
+    }
+
+    static bool HasRegression(const std::vector<CaseComparison>& comparisons)
+    {
+        for(const auto& comparison : comparisons)
+        {
+            for(const auto& metric : comparison.metrics)
+            {
+                if(metric.change == MetricChange::Regressed)
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    static size_t CountMissingCases(const std::vector<CaseComparison>& comparisons)
+    {
+        size_t missing = 0;
+        for(const auto& comparison : comparisons)
+        {
+            missing += (comparison.in_current || comparison.skipped) ? 0 : 1;
+        }
+        return missing;
+    }
+
+private:
+    template <typename T>
+    static std::vector<double> collect(const EvalCase& eval_case, T EvalSample::*field)
+    {
+        std::vector<double> values;
+        for(const auto& sample : eval_case.samples)
+        {
+            values.push_back(static_cast<double>(sample.*field));
+        }
+        return values;
+    }
+
+    static std::vector<double> collectIncremental(const EvalCase& eval_case)
+    {
+        std::vector<double> values;
+        for(const auto& sample : eval_case.samples)
+        {
+            values.push_back(std::max(0.0, sample.duration - sample.old_index_build_duration));
+        }
+        return values;
+    }
+
+    MetricComparison compareMetric(const std::string& metric, double threshold,
+                                   const std::vector<double>& baseline_values,
+                                   const std::vector<double>& current_values) const
+    {
+        MetricComparison comparison;
+        comparison.metric = metric;
+        comparison.baseline_mean = eval_stats::Mean(baseline_values);
+        comparison.current_mean = eval_stats::Mean(current_values);
+        comparison.p_value = eval_stats::WelchTTestPValue(baseline_values, current_values);
+        if(comparison.baseline_mean > 0.0)
+        {
+            comparison.relative_change = (comparison.current_mean - comparison.baseline_mean) / comparison.baseline_mean;
+        }
+        else if(comparison.current_mean > 0.0)
+        {
+            comparison.relative_change = 1.0; // Grew from nothing
+        }
+
+        // A change must be both statistically significant and larger than the threshold
+        if(comparison.p_value < thresholds.alpha && std::fabs(comparison.relative_change) > threshold)
+        {
+            comparison.change = comparison.relative_change > 0.0 ? MetricChange::Regressed : MetricChange::Improved;
+        }
+        return comparison;
+    }
+
+    RegressionThresholds thresholds;
+};
+
+#endif // EVAL_BASELINE_H
@@ -0,0 +1,146 @@
+/*
+    Small statistics helpers shared by the evaluation modes
+*/
+#ifndef EVAL_STATS_H
+#define EVAL_STATS_H
+
+#include <vector>
+#include <cmath>
+#include <cstddef>
+
+namespace eval_stats
+{
+
+inline double Mean(const std::vector<double>& values)
+{
+    if(values.empty())
+    {
+        return 0.0;
+    }
+    double sum = 0.0;
+    for(double value : values)
+    {
+        sum += value;
+    }
+    return sum / static_cast<double>(values.size());
+}
+
+// Unbiased sample variance, 0 for fewer than two values
+inline double Variance(const std::vector<double>& values)
+{
+    if(values.size() < 2)
+    {
+        return 0.0;
+    }
+    double mean = Mean(values);
+    double sum = 0.0;
+    for(double value : values)
+    {
+        sum += (value - mean) * (value - mean);
+    }
+    return sum / static_cast<double>(values.size() - 1);
+}
+
+// Continued fraction for the regularized incomplete beta function (modified Lentz)
+inline double incompleteBetaFraction(double a, double b, double x)
+{
+    constexpr int max_iter = 200;
+    constexpr double eps = 1e-12;
+    constexpr double tiny = 1e-300;
+
+    double qab = a + b;
+    double qap = a + 1.0;
+    double qam = a - 1.0;
+    double c = 1.0;
+    double d = 1.0 - qab * x / qap;
+    if(std::fabs(d) < tiny)
+    {
+        d = tiny;
+    }
+    d = 1.0 / d;
+    double h = d;
+    for(int m = 1; m <= max_iter; ++m)
+    {
+        int m2 = 2 * m;
+        double aa = m * (b - m) * x / ((qam + m2) * (a + m2));
+        d = 1.0 + aa * d;
+        if(std::fabs(d) < tiny)
+        {
+            d = tiny;
+        }
+        c = 1.0 + aa / c;
+        if(std::fabs(c) < tiny)
+        {
+            c = tiny;
+        }
+        d = 1.0 / d;
+        h *= d * c;
+        aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2));
+        d = 1.0 + aa * d;
+        if(std::fabs(d) < tiny)
+        {
+            d = tiny;
+        }
+        c = 1.0 + aa / c;
+        if(std::fabs(c) < tiny)
+        {
+            c = tiny;
+        }
+        d = 1.0 / d;
+        double del = d * c;
+        h *= del;
+        if(std::fabs(del - 1.0) < eps)
+        {
+            break;
+        }
+    }
+    return h;
+}
+
+// Regularized incomplete beta function I_x(a, b)
+inline double IncompleteBeta(double a, double b, double x)
+{
+    if(x <= 0.0)
+    {
+        return 0.0;
+    }
+    if(x >= 1.0)
+    {
+        return 1.0;
+    }
+    double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b)
+                            + a * std::log(x) + b * std::log(1.0 - x));
+    if(x < (a + 1.0) / (a + b + 2.0))
+    {
+        return front * incompleteBetaFraction(a, b, x) / a;
+    }
+    return 1.0 - front * incompleteBetaFraction(b, a, 1.0 - x) / b;
+}
+
+// Two-sided p-value of Welch's t-test for a difference in means.
+// Degenerate inputs (fewer than two samples or zero variance) fall back to
+// an exact comparison of the means: 0 when they differ, 1 when they do not.
+inline double WelchTTestPValue(const std::vector<double>& a, const std::vector<double>& b)
+{
+    double mean_a = Mean(a);
+    double mean_b = Mean(b);
+    if(a.size() < 2 || b.size() < 2)
+    {
+        return mean_a == mean_b ? 1.0 : 0.0;
+    }
+    double se_a = Variance(a) / static_cast<double>(a.size());
+    double se_b = Variance(b) / static_cast<double>(b.size());
+    double se = se_a + se_b;
+    if(se <= 0.0)
+    {
+        return mean_a == mean_b ? 1.0 : 0.0;
+    }
+    double t = (mean_a - mean_b) / std::sqrt(se);
+    double df = se * se / (se_a * se_a / static_cast<double>(a.size() - 1)
+                           + se_b * se_b / static_cast<double>(b.size() - 1));
+    return IncompleteBeta(df / 2.0, 0.5, df / (df + t * t));
+}
+
+} // namespace eval_stats
+
+#endif // EVAL_STATS_H
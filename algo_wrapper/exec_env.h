@@ -0,0 +1,612 @@
+/*
+    Execution environment control for reproducible measurements
+
+    Pins evaluations to CPU sets, hands concurrent jobs disjoint CPUs (within
+    one NUMA node where possible) and captures the CPU model, frequency
+    governor, observed frequency and load average an evaluation ran under.
+    Pinning and frequency data are only available on Linux; on Windows the
+    thread affinity is set for the first 64 CPUs and the rest is left unknown.
+*/
+#ifndef EXEC_ENV_H
+#define EXEC_ENV_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <chrono>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+#include "base_algo_wrapper.h"
+#include "alloc_profiler.h"
+
+struct NoiseThresholds
+{
+    double max_load_per_free_cpu = 0.5; // Load of other processes per CPU outside the evaluation's set above which they compete for CPUs
+    double min_freq_ratio = 0.90; // Observed / maximum frequency below which the CPU is scaled down or throttled
+    double max_freq_drift = 0.10; // Relative frequency change between start and finish
+    bool require_pinning = false; // Warn about unpinned runs; RunEvalInEnv turns it on when CPUs were requested
+    bool require_performance_governor = true;
+};
+
+namespace exec_env_detail
+{
+
+inline std::string readFirstLine(const std::string& file_path)
+{
+    std::ifstream file(file_path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+// Parses kernel CPU lists such as "0-3,8,10-11"
+inline std::vector<int> parseCpuList(const std::string& text)
+{
+    std::vector<int> cpus;
+    std::stringstream stream(text);
+    std::string part;
+    while(std::getline(stream, part, ','))
+    {
+        if(part.empty())
+        {
+            continue;
+        }
+        size_t dash = part.find('-');
+        int first = std::atoi(part.substr(0, dash).c_str());
+        int last = (dash == std::string::npos) ? first : std::atoi(part.substr(dash + 1).c_str());
+        for(int cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+} // namespace exec_env_detail
+
+// Pins the calling thread for its lifetime and restores the previous affinity.
+// On Linux threads started by the engine inherit the pinned mask.
+class ScopedCpuAffinity
+{
+public:
+    explicit ScopedCpuAffinity(const std::vector<int>& cpus)
+    {
+        if(cpus.empty())
+        {
+            return; // Nothing to pin
+        }
+#if defined(__linux__)
+        CPU_ZERO(&previous_mask);
+        if(sched_getaffinity(0, sizeof(previous_mask), &previous_mask) != 0)
+        {
+            return;
+        }
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        for(int cpu : cpus)
+        {
+            if(cpu >= 0 && cpu < CPU_SETSIZE)
+            {
+                CPU_SET(cpu, &mask);
+            }
+        }
+        pinned = (sched_setaffinity(0, sizeof(mask), &mask) == 0);
+#elif defined(_WIN32)
+        DWORD_PTR mask = 0;
+        for(int cpu : cpus)
+        {
+            if(cpu >= 0 && cpu < 64)
+            {
+                mask |= (static_cast<DWORD_PTR>(1) << cpu);
+            }
+        }
+        previous_mask = SetThreadAffinityMask(GetCurrentThread(), mask);
+        pinned = (previous_mask != 0);
+#endif
+    }
+    ~ScopedCpuAffinity()
+    {
+        if(!pinned)
+        {
+            return;
+        }
+#if defined(__linux__)
+        sched_setaffinity(0, sizeof(previous_mask), &previous_mask);
+#elif defined(_WIN32)
+        SetThreadAffinityMask(GetCurrentThread(), previous_mask);
+#endif
+    }
+    ScopedCpuAffinity(const ScopedCpuAffinity&) = delete;
+    ScopedCpuAffinity& operator=(const ScopedCpuAffinity&) = delete;
+
+    bool IsPinned() const { return pinned; }
+
+private:
+    bool pinned = false;
+#if defined(__linux__)
+    cpu_set_t previous_mask;
+#elif defined(_WIN32)
+    DWORD_PTR previous_mask = 0;
+#endif
+};
+
+class ExecEnvController
+{
+public:
+    ExecEnvController()
+    {
+        cpu_set = GetAvailableCpus();
+    }
+    ~ExecEnvController() = default;
+
+    // CPUs usable by evaluations, must be a subset of the available CPUs
+    int SetCpuSet(const std::vector<int>& cpus)
+    {
+        std::lock_guard<std::mutex> lock(env_mutex); // Lock the mutex for thread safety
+        if(cpus.empty() || !busy_cpus.empty())
+        {
+            return -1; // Empty set or jobs still hold CPUs
+        }
+        std::vector<int> available = GetAvailableCpus();
+        for(int cpu : cpus)
+        {
+            if(std::find(available.begin(), available.end(), cpu) == available.end())
+            {
+                return -1; // CPU not available to this process
+            }
+        }
+        cpu_set = cpus;
+        return 0; // Success
+    }
+
+    std::vector<int> GetCpuSet()
+    {
+        std::lock_guard<std::mutex> lock(env_mutex); // Lock the mutex for thread safety
+        return cpu_set;
+    }
+
+    // Reserves cpu_count CPUs that no other running job holds, preferring CPUs of
+    // a single NUMA node so a job never straddles memory controllers
+    int AcquireCpuSlice(size_t cpu_count, std::vector<int>& slice)
+    {
+        std::lock_guard<std::mutex> lock(env_mutex); // Lock the mutex for thread safety
+        slice.clear();
+        if(cpu_count == 0)
+        {
+            return -1; // Invalid request
+        }
+
+        std::map<int, std::vector<int>> free_by_node;
+        for(int cpu : cpu_set)
+        {
+            if(busy_cpus.count(cpu) == 0)
+            {
+                free_by_node[GetNumaNode(cpu)].push_back(cpu);
+            }
+        }
+        for(const auto& pair : free_by_node)
+        {
+            if(pair.second.size() >= cpu_count)
+            {
+                slice.assign(pair.second.begin(), pair.second.begin() + static_cast<std::ptrdiff_t>(cpu_count));
+                break;
+            }
+        }
+        if(slice.empty())
+        {
+            for(const auto& pair : free_by_node)
+            {
+                for(int cpu : pair.second)
+                {
+                    if(slice.size() < cpu_count)
+                    {
+                        slice.push_back(cpu);
+                    }
+                }
+            }
+            if(slice.size() < cpu_count)
+            {
+                slice.clear();
+                return -1; // Not enough free CPUs
+            }
+        }
+        busy_cpus.insert(slice.begin(), slice.end());
+        return 0; // Success
+    }
+
+    void ReleaseCpuSlice(const std::vector<int>& slice)
+    {
+        std::lock_guard<std::mutex> lock(env_mutex); // Lock the mutex for thread safety
+        for(int cpu : slice)
+        {
+            busy_cpus.erase(cpu);
+        }
+    }
+
+    // Parses CPU lists such as "0-3,8"
+    static std::vector<int> ParseCpuList(const std::string& text)
+    {
+        return exec_env_detail::parseCpuList(text);
+    }
+
+    static std::vector<int> GetAvailableCpus()
+    {
+        std::vector<int> cpus;
+#if defined(__linux__)
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        if(sched_getaffinity(0, sizeof(mask), &mask) == 0)
+        {
+            for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if(CPU_ISSET(cpu, &mask))
+                {
+                    cpus.push_back(cpu);
+                }
+            }
+        }
+#endif
+        if(cpus.empty())
+        {
+            unsigned int count = std::max(1u, std::thread::hardware_concurrency());
+            for(unsigned int cpu = 0; cpu < count; ++cpu)
+            {
+                cpus.push_back(static_cast<int>(cpu));
+            }
+        }
+        return cpus;
+    }
+
+    static int GetNumaNode(int cpu)
+    {
+        const std::map<int, int>& node_map = numaNodeMap();
+        auto it = node_map.find(cpu);
+        return it == node_map.end() ? -1 : it->second; // -1 when unknown
+    }
+
+    // Resident set size of the whole process in bytes, 0 when unavailable
+    static uint64_t GetProcessRss()
+    {
+#if defined(__linux__)
+        std::ifstream statm("/proc/self/statm");
+        uint64_t total_pages = 0, resident_pages = 0;
+        if(!(statm >> total_pages >> resident_pages))
+        {
+            return 0;
+        }
+        return resident_pages * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#elif defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        if(!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            return 0;
+        }
+        return static_cast<uint64_t>(counters.WorkingSetSize);
+#else
+        return 0;
+#endif
+    }
+
+    // I/O counters of this process, io_stats.profiled is false when the platform has none.
+    // Linux reads /proc/self/io, Windows has no storage level byte counts.
+    static int GetProcessIo(AlgoEvalIoStats& io_stats)
+    {
+        io_stats = AlgoEvalIoStats();
+#if defined(__linux__)
+        std::ifstream file("/proc/self/io");
+        std::string key;
+        uint64_t value = 0;
+        while(file >> key >> value)
+        {
+            if(key == "rchar:") io_stats.rchar = value;
+            else if(key == "wchar:") io_stats.wchar = value;
+            else if(key == "syscr:") io_stats.syscr = value;
+            else if(key == "syscw:") io_stats.syscw = value;
+            else if(key == "read_bytes:") io_stats.read_bytes = value;
+            else if(key == "write_bytes:") io_stats.write_bytes = value;
+            io_stats.profiled = true;
+        }
+#elif defined(_WIN32)
+        IO_COUNTERS counters;
+        if(GetProcessIoCounters(GetCurrentProcess(), &counters))
+        {
+            io_stats.rchar = counters.ReadTransferCount;
+            io_stats.wchar = counters.WriteTransferCount;
+            io_stats.syscr = counters.ReadOperationCount;
+            io_stats.syscw = counters.WriteOperationCount;
+            io_stats.profiled = true;
+        }
+#endif
+        return io_stats.profiled ? 0 : -1;
+    }
+    static AlgoEvalIoStats DiffProcessIo(const AlgoEvalIoStats& before, const AlgoEvalIoStats& after)
+    {
+        auto delta = [](uint64_t from, uint64_t to) { return to > from ? to - from : 0; };
+        AlgoEvalIoStats io_stats;
+        io_stats.profiled = before.profiled && after.profiled;
+        io_stats.rchar = delta(before.rchar, after.rchar);
+        io_stats.wchar = delta(before.wchar, after.wchar);
+        io_stats.syscr = delta(before.syscr, after.syscr);
+        io_stats.syscw = delta(before.syscw, after.syscw);
+        io_stats.read_bytes = delta(before.read_bytes, after.read_bytes);
+        io_stats.write_bytes = delta(before.write_bytes, after.write_bytes);
+        return io_stats;
+    }
+
+    // Captures the environment of the given CPUs (all available CPUs when empty).
+    // Call once before and once after an evaluation and merge with MergeSnapshots().
+    static AlgoEvalEnv CaptureSnapshot(const std::vector<int>& pinned_cpus)
+    {
+        AlgoEvalEnv env;
+        env.cpu_set = pinned_cpus;
+        env.cpu_model = readCpuModel();
+        std::vector<int> cpus = pinned_cpus.empty() ? GetAvailableCpus() : pinned_cpus;
+
+#if defined(__linux__)
+        double freq_sum = 0.0;
+        double freq_max_sum = 0.0;
+        int freq_count = 0;
+        for(int cpu : cpus)
+        {
+            std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/";
+            if(env.cpu_governor.empty())
+            {
+                env.cpu_governor = exec_env_detail::readFirstLine(base + "scaling_governor");
+            }
+            std::string cur = exec_env_detail::readFirstLine(base + "scaling_cur_freq");
+            std::string max = exec_env_detail::readFirstLine(base + "cpuinfo_max_freq");
+            if(!cur.empty() && !max.empty())
+            {
+                freq_sum += std::atof(cur.c_str()) / 1000.0; // kHz to MHz
+                freq_max_sum += std::atof(max.c_str()) / 1000.0;
+                freq_count++;
+            }
+        }
+        if(freq_count > 0)
+        {
+            env.cpu_freq_mhz = freq_sum / freq_count;
+            env.cpu_freq_max_mhz = freq_max_sum / freq_count;
+        }
+
+        std::string loadavg = exec_env_detail::readFirstLine("/proc/loadavg");
+        if(!loadavg.empty())
+        {
+            env.load_avg = std::atof(loadavg.c_str());
+        }
+#endif
+
+        int node = cpus.empty() ? -1 : GetNumaNode(cpus.front());
+        for(int cpu : cpus)
+        {
+            if(GetNumaNode(cpu) != node)
+            {
+                node = -1; // Spans several nodes
+                break;
+            }
+        }
+        env.numa_node = node;
+        env.capture_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        env.process_cpu_seconds = getProcessCpuSeconds();
+        return env;
+    }
+
+    // Combines the snapshots taken before and after an evaluation and adds
+    // warnings for conditions that make the measurement noisy
+    static AlgoEvalEnv MergeSnapshots(const AlgoEvalEnv& before, const AlgoEvalEnv& after, const NoiseThresholds& thresholds)
+    {
+        AlgoEvalEnv env = after;
+        if(before.cpu_freq_mhz > 0.0 && after.cpu_freq_mhz > 0.0)
+        {
+            env.cpu_freq_mhz = (before.cpu_freq_mhz + after.cpu_freq_mhz) / 2.0;
+            double drift = std::abs(after.cpu_freq_mhz - before.cpu_freq_mhz) / before.cpu_freq_mhz;
+            if(drift > thresholds.max_freq_drift)
+            {
+                env.warnings.push_back("CPU frequency changed by " + std::to_string(static_cast<int>(drift * 100.0)) + "% during the evaluation");
+            }
+        }
+        env.load_avg = std::max(before.load_avg, after.load_avg);
+
+        // The evaluation's own threads count towards the load average, so only
+        // the rest is held against the CPUs the evaluation leaves to other work
+        double wall_seconds = after.capture_seconds - before.capture_seconds;
+        double own_load = 0.0;
+        if(before.process_cpu_seconds >= 0.0 && after.process_cpu_seconds >= 0.0 && wall_seconds > 0.0)
+        {
+            own_load = (after.process_cpu_seconds - before.process_cpu_seconds) / wall_seconds;
+        }
+        if(env.load_avg >= 0.0)
+        {
+            env.other_load = std::max(0.0, env.load_avg - own_load);
+        }
+        size_t total_cpus = std::max(1u, std::thread::hardware_concurrency());
+        size_t busy_cpus = env.cpu_set.empty() ? static_cast<size_t>(std::ceil(own_load)) : env.cpu_set.size();
+        size_t free_cpus = std::max<size_t>(1, total_cpus > busy_cpus ? total_cpus - busy_cpus : 0);
+        double max_other_load = thresholds.max_load_per_free_cpu * static_cast<double>(free_cpus);
+
+        if(thresholds.require_pinning && env.cpu_set.empty())
+        {
+            env.warnings.push_back("evaluation was not pinned to a CPU set");
+        }
+        if(thresholds.require_performance_governor && !env.cpu_governor.empty() && env.cpu_governor != "performance")
+        {
+            env.warnings.push_back("CPU governor is '" + env.cpu_governor + "', not 'performance'");
+        }
+        if(env.cpu_freq_max_mhz > 0.0 && env.cpu_freq_mhz < env.cpu_freq_max_mhz * thresholds.min_freq_ratio)
+        {
+            env.warnings.push_back("CPU ran at " + std::to_string(static_cast<int>(env.cpu_freq_mhz)) + " of "
+                                   + std::to_string(static_cast<int>(env.cpu_freq_max_mhz)) + " MHz");
+        }
+        if(env.other_load > max_other_load)
+        {
+            std::ostringstream text;
+            text << "load average " << env.load_avg << ", " << env.other_load << " from other processes, above "
+                 << max_other_load << " for " << free_cpus << " free CPU(s)";
+            env.warnings.push_back(text.str());
+        }
+        return env;
+    }
+
+private:
+    // CPU -> NUMA node, read from sysfs once since the topology does not change while running
+    static const std::map<int, int>& numaNodeMap()
+    {
+        static const std::map<int, int> node_map = []() {
+            std::map<int, int> cpu_nodes;
+#if defined(__linux__)
+            for(int node = 0; node < 64; ++node)
+            {
+                std::string cpulist = exec_env_detail::readFirstLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+                for(int cpu : exec_env_detail::parseCpuList(cpulist))
+                {
+                    cpu_nodes.emplace(cpu, node);
+                }
+            }
+#endif
+            return cpu_nodes;
+        }();
+        return node_map;
+    }
+
+    // User plus system time of the whole process, negative when unavailable
+    static double getProcessCpuSeconds()
+    {
+#if defined(__linux__)
+        struct rusage usage;
+        if(getrusage(RUSAGE_SELF, &usage) == 0)
+        {
+            return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+                + static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+        }
+#elif defined(_WIN32)
+        FILETIME creation_time, exit_time, kernel_time, user_time;
+        if(GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+        {
+            auto toSeconds = [](const FILETIME& time) {
+                return static_cast<double>((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 1e7; // 100 ns units
+            };
+            return toSeconds(kernel_time) + toSeconds(user_time);
+        }
+#endif
+        return -1.0;
+    }
+
+    static std::string readCpuModel()
+    {
+#if defined(__linux__)
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while(std::getline(cpuinfo, line))
+        {
+            if(line.compare(0, 10, "model name") == 0)
+            {
+                size_t colon = line.find(':');
+                if(colon != std::string::npos && colon + 2 <= line.size())
+                {
+                    return line.substr(colon + 2);
+                }
+            }
+        }
+        return "";
+#else
+        const char* identifier = std::getenv("PROCESSOR_IDENTIFIER");
+        return identifier ? identifier : "";
+#endif
+    }
+
+    std::vector<int> cpu_set; // CPUs evaluations may use
+    std::set<int> busy_cpus; // CPUs held by running jobs
+    std::mutex env_mutex; // Mutex for thread safety
+};
+
+// Optional measurements taken around StartEval by RunEvalInEnv
+struct EvalProbeOptions
+{
+    bool profile_allocations = false; // Count heap allocations (see alloc_profiler.h)
+    bool profile_io = false; // Process I/O counter deltas
+    bool trace_old_reads = false; // Read offsets of the old input, for wrappers that report them
+};
+
+// Runs one evaluation pinned to cpus (unpinned when empty) and attaches the
+// captured environment and the requested probes to the result.
+inline int RunEvalInEnv(BaseAlgoWrapper& wrapper, const std::vector<int>& cpus,
+                        const NoiseThresholds& thresholds, AlgoEvalResult& result,
+                        const EvalProbeOptions& probes = EvalProbeOptions())
+{
+    ScopedCpuAffinity affinity(cpus);
+    std::vector<int> pinned_cpus = affinity.IsPinned() ? cpus : std::vector<int>();
+    AlgoEvalEnv before = ExecEnvController::CaptureSnapshot(pinned_cpus);
+    AlgoEvalAllocStats alloc_stats;
+    AlgoEvalIoStats io_before, io_after;
+    ReadOffsetTrace old_read_trace;
+    bool tracing = probes.trace_old_reads && wrapper.IsReadTraceSupported();
+    {
+        ScopedAllocProfile alloc_profile(probes.profile_allocations);
+        if(probes.profile_allocations && !alloc_profile.IsActive())
+        {
+            return -1; // This thread is already being profiled
+        }
+        if(tracing)
+        {
+            wrapper.SetOldReadTrace(&old_read_trace);
+        }
+        if(probes.profile_io)
+        {
+            ExecEnvController::GetProcessIo(io_before);
+        }
+        int ret = wrapper.StartEval();
+        if(probes.profile_io)
+        {
+            ExecEnvController::GetProcessIo(io_after);
+        }
+        wrapper.SetOldReadTrace(nullptr);
+        if(ret != 0)
+        {
+            return -1; // Evaluation failed
+        }
+        alloc_profile.Finish(alloc_stats);
+    }
+    AlgoEvalEnv after = ExecEnvController::CaptureSnapshot(pinned_cpus);
+    if(wrapper.GetEvalResult(result) != 0)
+    {
+        return -1; // Failed to get the result
+    }
+    if(result.SetEvalAllocStats(alloc_stats) != 0)
+    {
+        return -1; // Failed to set the allocation statistics
+    }
+    if(probes.profile_io && result.SetEvalIoStats(ExecEnvController::DiffProcessIo(io_before, io_after)) != 0)
+    {
+        return -1; // Failed to set the I/O statistics
+    }
+    AlgoIoAccessSummary old_read_access;
+    if(tracing && (old_read_trace.Summarize(old_read_access) != 0 || result.SetEvalOldReadAccess(old_read_access) != 0))
+    {
+        return -1; // Failed to set the access pattern
+    }
+    NoiseThresholds effective_thresholds = thresholds;
+    effective_thresholds.require_pinning = thresholds.require_pinning || !cpus.empty(); // Only a failed pin is noise
+    return result.SetEvalEnv(ExecEnvController::MergeSnapshots(before, after, effective_thresholds));
+}
+
+#endif // EXEC_ENV_H
@@ -0,0 +1,544 @@
+/*
+    Similarity pre-analysis and algorithm scheduling
+
+    InputProfiler makes one pass over each input. A gear rolling hash over 64
+    byte windows picks content-defined anchors, about one window in 32, so
+    the same content is sampled in both inputs whatever its offset. The
+    anchored windows feed a bottom-k MinHash sketch kept in a flat array.
+    Byte histograms of every 4th 4 KiB block give the entropy through a
+    count * log2(count) table. The per byte work is a table load, a shift
+    and an add, so the pass runs at a large fraction of memory bandwidth.
+    Magic numbers and the entropy classify the content.
+
+    AlgoScheduler uses the profile to order the algorithms by how often each
+    won on inputs of the same profile (AlgoWinHistory), to keep only the
+    likeliest winners, and to skip pairs no delta can help.
+*/
+#ifndef INPUT_PROFILE_H
+#define INPUT_PROFILE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+#include <QFile>
+#include <QIODevice>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "base_algo_wrapper.h"
+
+class InputProfiler
+{
+public:
+    static constexpr size_t SketchSize = 2048; // Hashes kept per input, the estimate error is about 1/sqrt(SketchSize)
+    static constexpr size_t WindowSize = 64; // Bytes covered by one rolling hash
+    static constexpr size_t BlockSize = 4096; // Entropy granularity
+    static constexpr size_t EntropyBlockStride = 4; // Every 4th block is histogrammed
+    static constexpr unsigned MaxAnchorBits = 8; // At most one window in 256 is sampled
+    static constexpr size_t HashLanes = 4; // Independent hash chains interleaved in one loop
+    static constexpr double HighEntropy = 7.5; // Bits per byte above which a block counts as compressed
+
+    static int Analyze(const uint8_t* old_data, size_t old_size, const uint8_t* new_data, size_t new_size, AlgoInputProfile& profile)
+    {
+        if((old_data == nullptr && old_size != 0) || (new_data == nullptr && new_size != 0))
+        {
+            return -1; // Invalid buffers
+        }
+        auto start = std::chrono::steady_clock::now();
+        profile = AlgoInputProfile();
+        profile.old_size = old_size;
+        profile.new_size = new_size;
+
+        // Both inputs must sample the same windows, so the anchor rate follows the larger one
+        uint64_t anchor_mask = anchorMask(std::max(old_size, new_size));
+        InputStats old_stats, new_stats;
+        scan(old_data, old_size, anchor_mask, old_stats);
+        scan(new_data, new_size, anchor_mask, new_stats);
+        profile.similarity = estimateSimilarity(old_stats.sketch, new_stats.sketch);
+        profile.old_entropy = old_stats.mean_entropy;
+        profile.new_entropy = new_stats.mean_entropy;
+        profile.new_high_entropy_ratio = new_stats.high_entropy_ratio;
+        profile.old_kind = classify(old_data, old_size, old_stats);
+        profile.new_kind = classify(new_data, new_size, new_stats);
+        profile.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        profile.analyzed = true;
+        return 0; // Success
+    }
+
+    // Coarse bucket the win history is kept per, e.g. "executable/sim75-95/1M-16M"
+    static std::string GetProfileKey(const AlgoInputProfile& profile)
+    {
+        static const double similarity_limits[] = {0.25, 0.50, 0.75, 0.95};
+        static const char* similarity_names[] = {"sim0-25", "sim25-50", "sim50-75", "sim75-95", "sim95-100"};
+        static const uint64_t size_limits[] = {1ULL << 20, 16ULL << 20, 256ULL << 20};
+        static const char* size_names[] = {"0-1M", "1M-16M", "16M-256M", "256M+"};
+        int similarity_bucket = 0;
+        while(similarity_bucket < 4 && profile.similarity >= similarity_limits[similarity_bucket])
+        {
+            similarity_bucket++;
+        }
+        int size_bucket = 0;
+        uint64_t size = std::max(profile.old_size, profile.new_size);
+        while(size_bucket < 3 && size >= size_limits[size_bucket])
+        {
+            size_bucket++;
+        }
+        return std::string(AlgoInputProfile::GetContentKindName(profile.new_kind)) + "/" + similarity_names[similarity_bucket]
+               + "/" + size_names[size_bucket];
+    }
+
+private:
+    struct InputStats
+    {
+        std::vector<uint64_t> sketch; // Smallest SketchSize distinct window hashes, sorted
+        double mean_entropy = 0.0;
+        double high_entropy_ratio = 0.0;
+    };
+
+    static const uint64_t* gearTable()
+    {
+        static const std::vector<uint64_t> table = []() {
+            std::vector<uint64_t> values(256);
+            uint64_t state = 0x9E3779B97F4A7C15ULL;
+            for(auto& value : values)
+            {
+                value = mix(state += 0x9E3779B97F4A7C15ULL);
+            }
+            return values;
+        }();
+        return table.data();
+    }
+
+    static uint64_t mix(uint64_t value) // splitmix64 finalizer
+    {
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        return value ^ (value >> 31);
+    }
+
+    // count * log2(count) for every count a block histogram can hold
+    static const double* countLogTable()
+    {
+        static const std::vector<double> table = []() {
+            std::vector<double> values(BlockSize + 1, 0.0);
+            for(size_t count = 1; count <= BlockSize; count++)
+            {
+                values[count] = static_cast<double>(count) * std::log2(static_cast<double>(count));
+            }
+            return values;
+        }();
+        return table.data();
+    }
+
+    // H = log2(n) - sum(c * log2(c)) / n
+    static double blockEntropy(const uint8_t* data, size_t size)
+    {
+        // Four partial histograms, so runs of one byte value do not serialize on a single counter
+        uint32_t histograms[4][256] = {};
+        size_t offset = 0;
+        for(; offset + 4 <= size; offset += 4)
+        {
+            histograms[0][data[offset]]++;
+            histograms[1][data[offset + 1]]++;
+            histograms[2][data[offset + 2]]++;
+            histograms[3][data[offset + 3]]++;
+        }
+        for(; offset < size; offset++)
+        {
+            histograms[0][data[offset]]++;
+        }
+        const double* count_log = countLogTable();
+        double sum = 0.0;
+        for(int value = 0; value < 256; value++)
+        {
+            sum += count_log[histograms[0][value] + histograms[1][value] + histograms[2][value] + histograms[3][value]];
+        }
+        return std::log2(static_cast<double>(size)) - sum / static_cast<double>(size);
+    }
+
+    // Keeps the SketchSize smallest distinct candidates, returns the new admission threshold
+    static uint64_t compactSketch(std::vector<uint64_t>& sketch)
+    {
+        std::sort(sketch.begin(), sketch.end());
+        sketch.erase(std::unique(sketch.begin(), sketch.end()), sketch.end());
+        if(sketch.size() < SketchSize)
+        {
+            return UINT64_MAX;
+        }
+        sketch.resize(SketchSize);
+        return sketch.back();
+    }
+
+    // Samples one window in 2^bits, fewer on small inputs so the sketch still fills up
+    static uint64_t anchorMask(size_t size)
+    {
+        unsigned bits = 0;
+        while(bits < MaxAnchorBits && (size >> (bits + 1)) >= SketchSize * 4)
+        {
+            bits++;
+        }
+        return bits == 0 ? 0 : ~(UINT64_MAX >> bits);
+    }
+
+    static void scan(const uint8_t* data, size_t size, uint64_t anchor_mask, InputStats& stats)
+    {
+        stats.sketch.clear();
+        stats.sketch.reserve(SketchSize * 4);
+        uint64_t threshold = UINT64_MAX; // Largest hash in a full sketch
+        auto offer = [&stats, &threshold](uint64_t hash) {
+            uint64_t window_hash = mix(hash);
+            if(window_hash < threshold)
+            {
+                stats.sketch.push_back(window_hash);
+                if(stats.sketch.size() == SketchSize * 4)
+                {
+                    threshold = compactSketch(stats.sketch);
+                }
+            }
+        };
+
+        // The gear hash shifts one bit per byte, so it depends on the last 64 bytes only.
+        // That makes the input splittable: each of the four lanes starts its hash over the
+        // 63 bytes before its range, and the lanes run interleaved to hide the chain latency.
+        const uint64_t* gear = gearTable();
+        if(size >= WindowSize)
+        {
+            size_t lane_begin[HashLanes], lane_end[HashLanes];
+            uint64_t lane_hash[HashLanes];
+            size_t common = SIZE_MAX;
+            for(size_t lane = 0; lane < HashLanes; lane++)
+            {
+                lane_begin[lane] = std::max(lane * (size / HashLanes), WindowSize - 1);
+                lane_end[lane] = (lane + 1 == HashLanes) ? size : std::max((lane + 1) * (size / HashLanes), WindowSize - 1);
+                lane_hash[lane] = 0;
+                for(size_t offset = lane_begin[lane] - (WindowSize - 1); offset < lane_begin[lane]; offset++)
+                {
+                    lane_hash[lane] = (lane_hash[lane] << 1) + gear[data[offset]];
+                }
+                common = std::min(common, lane_end[lane] - lane_begin[lane]);
+            }
+
+            // Spelled out per lane, a loop over lane_hash keeps the hashes in memory at -O2
+            static_assert(HashLanes == 4, "the interleaved loop handles four lanes");
+            const uint8_t* data0 = data + lane_begin[0];
+            const uint8_t* data1 = data + lane_begin[1];
+            const uint8_t* data2 = data + lane_begin[2];
+            const uint8_t* data3 = data + lane_begin[3];
+            uint64_t hash0 = lane_hash[0], hash1 = lane_hash[1], hash2 = lane_hash[2], hash3 = lane_hash[3];
+            for(size_t step = 0; step < common; step++)
+            {
+                hash0 = (hash0 << 1) + gear[data0[step]];
+                hash1 = (hash1 << 1) + gear[data1[step]];
+                hash2 = (hash2 << 1) + gear[data2[step]];
+                hash3 = (hash3 << 1) + gear[data3[step]];
+                if(((hash0 & anchor_mask) == 0) | ((hash1 & anchor_mask) == 0) | ((hash2 & anchor_mask) == 0) | ((hash3 & anchor_mask) == 0))
+                {
+                    for(uint64_t hash : {hash0, hash1, hash2, hash3})
+                    {
+                        if((hash & anchor_mask) == 0)
+                        {
+                            offer(hash);
+                        }
+                    }
+                }
+            }
+            lane_hash[0] = hash0;
+            lane_hash[1] = hash1;
+            lane_hash[2] = hash2;
+            lane_hash[3] = hash3;
+
+            for(size_t lane = 0; lane < HashLanes; lane++)
+            {
+                for(size_t offset = lane_begin[lane] + common; offset < lane_end[lane]; offset++)
+                {
+                    lane_hash[lane] = (lane_hash[lane] << 1) + gear[data[offset]];
+                    if((lane_hash[lane] & anchor_mask) == 0)
+                    {
+                        offer(lane_hash[lane]);
+                    }
+                }
+            }
+        }
+        compactSketch(stats.sketch);
+
+        double entropy_sum = 0.0;
+        size_t blocks = 0, high_entropy_blocks = 0;
+        for(size_t block_start = 0; block_start < size; block_start += BlockSize * EntropyBlockStride)
+        {
+            double entropy = blockEntropy(data + block_start, std::min(BlockSize, size - block_start));
+            entropy_sum += entropy;
+            high_entropy_blocks += (entropy > HighEntropy) ? 1 : 0;
+            blocks++;
+        }
+        if(blocks > 0)
+        {
+            stats.mean_entropy = entropy_sum / static_cast<double>(blocks);
+            stats.high_entropy_ratio = static_cast<double>(high_entropy_blocks) / static_cast<double>(blocks);
+        }
+    }
+
+    // Bottom-k estimate: the share of the k smallest hashes of the union found in both sketches
+    static double estimateSimilarity(const std::vector<uint64_t>& old_sketch, const std::vector<uint64_t>& new_sketch)
+    {
+        if(old_sketch.empty() || new_sketch.empty())
+        {
+            return (old_sketch.empty() && new_sketch.empty()) ? 1.0 : 0.0;
+        }
+        auto old_it = old_sketch.begin();
+        auto new_it = new_sketch.begin();
+        size_t taken = 0, shared = 0;
+        while(taken < SketchSize && (old_it != old_sketch.end() || new_it != new_sketch.end()))
+        {
+            if(new_it == new_sketch.end() || (old_it != old_sketch.end() && *old_it < *new_it))
+            {
+                ++old_it;
+            }
+            else if(old_it == old_sketch.end() || *new_it < *old_it)
+            {
+                ++new_it;
+            }
+            else
+            {
+                ++old_it;
+                ++new_it;
+                shared++;
+            }
+            taken++;
+        }
+        return static_cast<double>(shared) / static_cast<double>(taken);
+    }
+
+    static AlgoContentKind classify(const uint8_t* data, size_t size, const InputStats& stats)
+    {
+        if(size == 0)
+        {
+            return AlgoContentKind::Unknown;
+        }
+        auto startsWith = [data, size](const char* magic, size_t magic_size) {
+            return size >= magic_size && std::memcmp(data, magic, magic_size) == 0;
+        };
+        if(startsWith("\x7F" "ELF", 4) || startsWith("MZ", 2) || startsWith("\xCF\xFA\xED\xFE", 4)
+            || startsWith("\xCE\xFA\xED\xFE", 4) || startsWith("\xFE\xED\xFA\xCF", 4) || startsWith("\xFE\xED\xFA\xCE", 4))
+        {
+            return AlgoContentKind::Executable;
+        }
+        if(startsWith("\x1F\x8B", 2) || startsWith("PK\x03\x04", 4) || startsWith("\xFD" "7zXZ", 5) || startsWith("\x28\xB5\x2F\xFD", 4)
+            || startsWith("BZh", 3) || startsWith("7z\xBC\xAF\x27\x1C", 6) || stats.high_entropy_ratio > 0.9)
+        {
+            return AlgoContentKind::Compressed;
+        }
+        size_t sample_size = std::min<size_t>(size, 64 * 1024);
+        size_t printable = 0;
+        for(size_t offset = 0; offset < sample_size; offset++)
+        {
+            uint8_t value = data[offset];
+            printable += (value >= 0x20 || value == '\n' || value == '\r' || value == '\t') ? 1 : 0;
+        }
+        return printable * 100 >= sample_size * 95 ? AlgoContentKind::Text : AlgoContentKind::Binary;
+    }
+};
+
+// How often each algorithm produced the smallest patch, per input profile key,
+// and how many pairs of each profile were scheduled
+class AlgoWinHistory
+{
+public:
+    AlgoWinHistory() = default;
+    ~AlgoWinHistory() = default;
+
+    void RecordWin(const std::string& profile_key, const std::string& algo_name)
+    {
+        std::lock_guard<std::mutex> lock(history_mutex); // Lock the mutex for thread safety
+        wins[profile_key][algo_name]++;
+    }
+
+    std::map<std::string, uint64_t> GetWins(const std::string& profile_key)
+    {
+        std::lock_guard<std::mutex> lock(history_mutex); // Lock the mutex for thread safety
+        auto it = wins.find(profile_key);
+        return it == wins.end() ? std::map<std::string, uint64_t>() : it->second;
+    }
+
+    // Counts a scheduled pair of the profile, returns how many were scheduled before it
+    uint64_t RecordScheduled(const std::string& profile_key)
+    {
+        std::lock_guard<std::mutex> lock(history_mutex); // Lock the mutex for thread safety
+        return scheduled[profile_key]++;
+    }
+
+    // Format: {"version": 1, "profiles": {"<profile key>": {"<algo>": <wins>}}, "scheduled": {"<profile key>": <pairs>}}
+    int SaveToFile(const std::string& file_path)
+    {
+        std::lock_guard<std::mutex> lock(history_mutex); // Lock the mutex for thread safety
+        QJsonObject profile_obj;
+        for(const auto& profile : wins)
+        {
+            QJsonObject win_obj;
+            for(const auto& win : profile.second)
+            {
+                win_obj[QString::fromStdString(win.first)] = static_cast<double>(win.second);
+            }
+            profile_obj[QString::fromStdString(profile.first)] = win_obj;
+        }
+        QJsonObject scheduled_obj;
+        for(const auto& profile : scheduled)
+        {
+            scheduled_obj[QString::fromStdString(profile.first)] = static_cast<double>(profile.second);
+        }
+        QJsonObject root;
+        root["version"] = 1;
+        root["profiles"] = profile_obj;
+        root["scheduled"] = scheduled_obj;
+
+        QFile file(QString::fromStdString(file_path));
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            return -1; // Failed to open the file
+        }
+        if(file.write(QJsonDocument(root).toJson()) < 0)
+        {
+            return -1; // Failed to write the file
+        }
+        return 0; // Success
+    }
+
+    int LoadFromFile(const std::string& file_path)
+    {
+        QFile file(QString::fromStdString(file_path));
+        if(!file.open(QIODevice::ReadOnly))
+        {
+            return -1; // Failed to open the file
+        }
+        QJsonParseError parse_error;
+        QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parse_error);
+        if(parse_error.error != QJsonParseError::NoError || !doc.isObject())
+        {
+            return -1; // Malformed file
+        }
+        QJsonObject root = doc.object();
+        if(root.value("version").toInt() != 1)
+        {
+            return -1; // Unsupported version
+        }
+
+        std::map<std::string, std::map<std::string, uint64_t>> loaded;
+        QJsonObject profile_obj = root.value("profiles").toObject();
+        for(const QString& profile_key : profile_obj.keys())
+        {
+            QJsonObject win_obj = profile_obj.value(profile_key).toObject();
+            for(const QString& algo_name : win_obj.keys())
+            {
+                loaded[profile_key.toStdString()][algo_name.toStdString()] = static_cast<uint64_t>(win_obj.value(algo_name).toDouble());
+            }
+        }
+        std::map<std::string, uint64_t> loaded_scheduled;
+        QJsonObject scheduled_obj = root.value("scheduled").toObject(); // Missing in older files
+        for(const QString& profile_key : scheduled_obj.keys())
+        {
+            loaded_scheduled[profile_key.toStdString()] = static_cast<uint64_t>(scheduled_obj.value(profile_key).toDouble());
+        }
+
+        std::lock_guard<std::mutex> lock(history_mutex); // Lock the mutex for thread safety
+        wins = std::move(loaded);
+        scheduled = std::move(loaded_scheduled);
+        return 0; // Success
+    }
+
+private:
+    std::map<std::string, std::map<std::string, uint64_t>> wins;
+    std::map<std::string, uint64_t> scheduled; // Pairs planned per profile, drives exploration
+    std::mutex history_mutex; // Mutex for thread safety
+};
+
+struct AlgoScheduleConfig
+{
+    double min_similarity = 0.02; // Below this, compressed new inputs are not worth a delta
+    size_t keep_top = 0; // Run only this many of the likeliest winners, 0 to run all
+    uint64_t min_history = 5; // Wins recorded for a profile before keep_top applies
+    uint64_t explore_every = 10; // With keep_top, every n-th pair of a profile still runs all algorithms, 0 never
+};
+
+struct AlgoSchedulePlan
+{
+    std::vector<std::string> algo_names; // In the order to run them
+    std::vector<std::pair<std::string, std::string>> skipped; // Algorithm and reason
+    bool full_run = false; // Every algorithm runs, so the winner is a fair one to record
+    bool exploring = false; // keep_top would have applied, but this pair runs everything
+};
+
+class AlgoScheduler
+{
+public:
+    AlgoScheduler(AlgoWinHistory& history, const AlgoScheduleConfig& config) : history(history), config(config) {}
+    ~AlgoScheduler() = default;
+
+    int Plan(const AlgoInputProfile& profile, const std::vector<std::string>& algo_names, AlgoSchedulePlan& plan)
+    {
+        plan = AlgoSchedulePlan();
+        if(!profile.analyzed)
+        {
+            return -1; // Inputs were not analyzed
+        }
+        if(profile.similarity < config.min_similarity && profile.new_kind == AlgoContentKind::Compressed)
+        {
+            for(const auto& algo_name : algo_names)
+            {
+                plan.skipped.emplace_back(algo_name, "inputs share nothing and the new input is compressed");
+            }
+            return 0; // Success
+        }
+
+        // Most wins first, the configured order breaks ties
+        std::string profile_key = InputProfiler::GetProfileKey(profile);
+        std::map<std::string, uint64_t> wins = history.GetWins(profile_key);
+        uint64_t scheduled_before = history.RecordScheduled(profile_key);
+        uint64_t total_wins = 0;
+        for(const auto& win : wins)
+        {
+            total_wins += win.second;
+        }
+        std::vector<std::string> ordered = algo_names;
+        std::stable_sort(ordered.begin(), ordered.end(), [&wins](const std::string& a, const std::string& b) {
+            auto a_it = wins.find(a);
+            auto b_it = wins.find(b);
+            return (a_it == wins.end() ? 0 : a_it->second) > (b_it == wins.end() ? 0 : b_it->second);
+        });
+        // Only full runs feed the history, so without exploring an engine that dropped
+        // out of the top could never win again
+        bool keep_top = config.keep_top > 0 && total_wins >= config.min_history && config.keep_top < ordered.size();
+        if(keep_top && config.explore_every > 0 && (scheduled_before + 1) % config.explore_every == 0)
+        {
+            keep_top = false;
+            plan.exploring = true;
+        }
+        plan.full_run = !keep_top;
+        for(size_t index = 0; index < ordered.size(); index++)
+        {
+            if(keep_top && index >= config.keep_top)
+            {
+                plan.skipped.emplace_back(ordered[index], "not among the top " + std::to_string(config.keep_top)
+                                                              + " on " + std::to_string(total_wins) + " similar pairs");
+            }
+            else
+            {
+                plan.algo_names.push_back(ordered[index]);
+            }
+        }
+        return 0; // Success
+    }
+
+private:
+    AlgoWinHistory& history;
+    AlgoScheduleConfig config;
+};
+
+#endif // INPUT_PROFILE_H
@@ -0,0 +1,162 @@
+/*
+    I/O profile of an evaluation
+
+    Process level counters (bytes and read/write syscalls, see
+    ExecEnvController::GetProcessIo) are taken before and after StartEval.
+    They cover the whole process, so profile one evaluation at a time.
+    Optionally the offsets a wrapper reads from the old input are traced and
+    summarized into sequential versus random access, the distribution of seek
+    distances and the working set.
+*/
+#ifndef IO_PROFILE_H
+#define IO_PROFILE_H
+
+#include <vector>
+#include <mutex>
+#include <unordered_set>
+#include <cstdint>
+#include <cstddef>
+
+// I/O counter deltas of one evaluation, filled by the runner (see exec_env.h)
+struct AlgoEvalIoStats
+{
+    bool profiled = false; // False when the platform exposes no counters or profiling was off
+    uint64_t rchar = 0; // Bytes passed to read calls, including page cache hits
+    uint64_t wchar = 0; // Bytes passed to write calls
+    uint64_t syscr = 0; // Read syscalls
+    uint64_t syscw = 0; // Write syscalls
+    uint64_t read_bytes = 0; // Bytes fetched from storage, 0 where unknown (Windows)
+    uint64_t write_bytes = 0; // Bytes sent to storage, 0 where unknown (Windows)
+};
+
+// Access pattern of the traced reads of one input
+struct AlgoIoAccessSummary
+{
+    static constexpr int SeekClassCount = 6; // backward, <=4K, <=64K, <=1M, <=16M, >16M forward
+    static constexpr uint64_t PageSize = 4096; // Granularity of the working set
+
+    bool traced = false;
+    uint64_t reads = 0;
+    uint64_t bytes_read = 0;
+    uint64_t sequential_reads = 0; // Started exactly where the previous read ended
+    uint64_t random_reads = 0;
+    uint64_t seek_classes[SeekClassCount] = {}; // Random reads by seek distance, sums to random_reads
+    uint64_t working_set_bytes = 0; // Distinct pages touched times PageSize
+    uint64_t dropped_reads = 0; // Reads not recorded because the trace was full
+
+    double GetSequentialRatio() const
+    {
+        return reads == 0 ? 0.0 : static_cast<double>(sequential_reads) / static_cast<double>(reads);
+    }
+    static const char* GetSeekClassName(int seek_class)
+    {
+        static const char* names[SeekClassCount] = {"backward", "<=4K", "<=64K", "<=1M", "<=16M", ">16M"};
+        return (seek_class >= 0 && seek_class < SeekClassCount) ? names[seek_class] : "";
+    }
+};
+
+// Records (offset, size) of every read in order, thread safe
+class ReadOffsetTrace
+{
+public:
+    explicit ReadOffsetTrace(size_t max_entries = 1 << 20) : max_entries(max_entries) {}
+    ~ReadOffsetTrace() = default;
+
+    void Record(uint64_t offset, uint64_t size)
+    {
+        std::lock_guard<std::mutex> lock(trace_mutex); // Lock the mutex for thread safety
+        if(size == 0)
+        {
+            return;
+        }
+        if(entries.size() >= max_entries)
+        {
+            dropped++;
+            return;
+        }
+        entries.push_back(Entry{offset, size});
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(trace_mutex); // Lock the mutex for thread safety
+        entries.clear();
+        dropped = 0;
+    }
+
+    int Summarize(AlgoIoAccessSummary& summary)
+    {
+        std::lock_guard<std::mutex> lock(trace_mutex); // Lock the mutex for thread safety
+        summary = AlgoIoAccessSummary();
+        summary.traced = true;
+        summary.dropped_reads = dropped;
+
+        std::unordered_set<uint64_t> pages;
+        bool has_previous = false;
+        uint64_t previous_end = 0;
+        for(const auto& entry : entries)
+        {
+            summary.reads++;
+            summary.bytes_read += entry.size;
+            if(has_previous && entry.offset == previous_end)
+            {
+                summary.sequential_reads++;
+            }
+            else if(has_previous)
+            {
+                summary.random_reads++;
+                summary.seek_classes[getSeekClass(previous_end, entry.offset)]++;
+            }
+            else if(entry.offset == 0)
+            {
+                summary.sequential_reads++; // The first read counts as sequential from the start
+            }
+            else
+            {
+                summary.random_reads++;
+                summary.seek_classes[getSeekClass(0, entry.offset)]++;
+            }
+            for(uint64_t page = entry.offset / AlgoIoAccessSummary::PageSize;
+                page <= (entry.offset + entry.size - 1) / AlgoIoAccessSummary::PageSize; page++)
+            {
+                pages.insert(page);
+            }
+            previous_end = entry.offset + entry.size;
+            has_previous = true;
+        }
+        summary.working_set_bytes = static_cast<uint64_t>(pages.size()) * AlgoIoAccessSummary::PageSize;
+        return 0; // Success
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    static int getSeekClass(uint64_t from, uint64_t to)
+    {
+        if(to < from)
+        {
+            return 0; // Backward
+        }
+        static const uint64_t limits[] = {4096ULL, 65536ULL, 1048576ULL, 16777216ULL};
+        uint64_t distance = to - from;
+        for(int index = 0; index < 4; index++)
+        {
+            if(distance <= limits[index])
+            {
+                return index + 1;
+            }
+        }
+        return AlgoIoAccessSummary::SeekClassCount - 1;
+    }
+
+    std::vector<Entry> entries;
+    size_t max_entries;
+    uint64_t dropped = 0;
+    std::mutex trace_mutex; // Mutex for thread safety
+};
+
+#endif // IO_PROFILE_H
@@ -0,0 +1,339 @@
+/*
+    Patch generation load test
+
+    Drives one wrapper with concurrent generation jobs drawn round robin from a
+    pool of input pairs, the way a patch server works on update day. In closed
+    loop mode every worker starts the next job as soon as its previous one
+    finished. In fixed rate mode jobs arrive on a schedule independent of the
+    workers, and latency is measured from the scheduled arrival so queueing
+    under saturation is part of it. The process RSS is sampled while the jobs
+    run to report the total memory footprint.
+*/
+#ifndef LOAD_TEST_H
+#define LOAD_TEST_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <cmath>
+#include <cstdint>
+
+#include "base_algo_wrapper.h"
+#include "algo_registry.h"
+#include "exec_env.h"
+
+enum class LoadTestMode
+{
+    ClosedLoop, // Each worker issues its next job when the previous one finished
+    FixedRate // Jobs arrive at arrival_rate per second regardless of completions
+};
+
+struct LoadTestPair
+{
+    std::string old_file_path;
+    std::string new_file_path;
+};
+
+struct LoadTestConfig
+{
+    LoadTestMode mode = LoadTestMode::ClosedLoop;
+    int concurrency = 1; // Jobs in flight at most
+    double arrival_rate = 0.0; // Jobs per second, fixed rate mode only
+    double duration_seconds = 10.0; // How long new jobs are issued
+    uint64_t max_jobs = 0; // Stop issuing after this many jobs, 0 for no limit
+    size_t cpus_per_job = 0; // Pin each worker to this many CPUs, 0 for no pinning
+    std::string scratch_dir; // Where workers write their patches, empty for the temporary directory
+};
+
+struct LoadTestResult
+{
+    int concurrency = 0;
+    uint64_t completed = 0;
+    uint64_t failed = 0;
+    uint64_t dropped = 0; // Fixed rate jobs still queued when the run ended
+    double wall_seconds = 0.0;
+    double throughput = 0.0; // Completed jobs per second
+    double latency_mean = 0.0; // Seconds
+    double latency_p50 = 0.0;
+    double latency_p90 = 0.0;
+    double latency_p99 = 0.0;
+    double latency_max = 0.0;
+    uint64_t rss_before = 0; // Process RSS in bytes before the first job
+    uint64_t rss_peak = 0; // Highest sampled process RSS while jobs ran
+    int unpinned_workers = 0; // Workers that could not get a CPU slice
+};
+
+class LoadTester
+{
+public:
+    // env_controller hands out CPU slices when cpus_per_job is set, may be null
+    LoadTester(const AlgoWrapperFactory& factory, const std::vector<LoadTestPair>& pairs, ExecEnvController* env_controller = nullptr)
+        : wrapper_factory(factory), input_pairs(pairs), env_controller(env_controller) {}
+    ~LoadTester() = default;
+
+    int Run(const LoadTestConfig& config, LoadTestResult& result)
+    {
+        result = LoadTestResult();
+        result.concurrency = config.concurrency;
+        if(!wrapper_factory || input_pairs.empty() || config.concurrency <= 0 || config.duration_seconds <= 0.0)
+        {
+            return -1; // Invalid configuration
+        }
+        if(config.mode == LoadTestMode::FixedRate && config.arrival_rate <= 0.0)
+        {
+            return -1; // Fixed rate needs an arrival rate
+        }
+        if(config.cpus_per_job > 0 && env_controller == nullptr)
+        {
+            return -1; // Pinning needs a controller
+        }
+
+        std::error_code ec;
+        std::filesystem::path scratch = config.scratch_dir.empty() ? std::filesystem::temp_directory_path(ec) : std::filesystem::path(config.scratch_dir);
+        if(ec)
+        {
+            return -1; // No scratch directory
+        }
+
+        RunState state;
+        state.config = config;
+        state.start = std::chrono::steady_clock::now();
+        state.issue_deadline = state.start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                 std::chrono::duration<double>(config.duration_seconds));
+        result.rss_before = ExecEnvController::GetProcessRss();
+        state.rss_peak = result.rss_before;
+
+        std::thread rss_sampler([&state]() {
+            while(!state.sampling_done.load())
+            {
+                uint64_t rss = ExecEnvController::GetProcessRss();
+                uint64_t peak = state.rss_peak.load();
+                while(rss > peak && !state.rss_peak.compare_exchange_weak(peak, rss))
+                {
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        });
+        std::thread dispatcher;
+        if(config.mode == LoadTestMode::FixedRate)
+        {
+            dispatcher = std::thread([this, &state]() { dispatchArrivals(state); });
+        }
+
+        // One patch file per worker, concurrent jobs on the same pair must not share it
+        std::vector<std::thread> workers;
+        std::vector<std::string> patch_paths;
+        std::string run_tag = std::to_string(state.start.time_since_epoch().count());
+        for(int worker = 0; worker < config.concurrency; worker++)
+        {
+            patch_paths.push_back((scratch / ("DiffAlgoEval_load_" + run_tag + "_" + std::to_string(worker) + ".patch")).string());
+        }
+        for(int worker = 0; worker < config.concurrency; worker++)
+        {
+            workers.emplace_back([this, &state, &patch_paths, worker]() { runWorker(state, patch_paths[static_cast<size_t>(worker)]); });
+        }
+        for(auto& worker : workers)
+        {
+            worker.join();
+        }
+        if(dispatcher.joinable())
+        {
+            dispatcher.join();
+        }
+        auto finish = std::chrono::steady_clock::now();
+        state.sampling_done = true;
+        rss_sampler.join();
+        for(const auto& patch_path : patch_paths)
+        {
+            std::filesystem::remove(patch_path, ec); // Best effort
+        }
+
+        result.completed = state.latencies.size();
+        result.failed = state.failed;
+        result.dropped = state.arrivals.size();
+        result.unpinned_workers = state.unpinned_workers;
+        result.rss_peak = state.rss_peak;
+        result.wall_seconds = std::chrono::duration<double>(finish - state.start).count();
+        result.throughput = result.wall_seconds > 0.0 ? static_cast<double>(result.completed) / result.wall_seconds : 0.0;
+        std::vector<double>& latencies = state.latencies;
+        std::sort(latencies.begin(), latencies.end());
+        if(!latencies.empty())
+        {
+            double sum = 0.0;
+            for(double latency : latencies)
+            {
+                sum += latency;
+            }
+            result.latency_mean = sum / static_cast<double>(latencies.size());
+            result.latency_p50 = Percentile(latencies, 0.50);
+            result.latency_p90 = Percentile(latencies, 0.90);
+            result.latency_p99 = Percentile(latencies, 0.99);
+            result.latency_max = latencies.back();
+        }
+        return 0; // Success
+    }
+
+    // Runs the same configuration at each concurrency level
+    int Sweep(const LoadTestConfig& config, const std::vector<int>& concurrency_levels, std::vector<LoadTestResult>& results)
+    {
+        results.clear();
+        for(int concurrency : concurrency_levels)
+        {
+            LoadTestConfig level_config = config;
+            level_config.concurrency = concurrency;
+            LoadTestResult result;
+            if(Run(level_config, result) != 0)
+            {
+                return -1; // Invalid configuration
+            }
+            results.push_back(result);
+        }
+        return 0; // Success
+    }
+
+    // Nearest rank percentile of sorted values, p in [0, 1]
+    static double Percentile(const std::vector<double>& sorted_values, double p)
+    {
+        if(sorted_values.empty())
+        {
+            return 0.0;
+        }
+        size_t rank = static_cast<size_t>(std::ceil(p * static_cast<double>(sorted_values.size())));
+        return sorted_values[std::min(sorted_values.size(), std::max<size_t>(rank, 1)) - 1];
+    }
+
+private:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    struct RunState
+    {
+        LoadTestConfig config;
+        TimePoint start;
+        TimePoint issue_deadline;
+        std::atomic<uint64_t> issued{0};
+        std::atomic<bool> sampling_done{false};
+        std::atomic<uint64_t> rss_peak{0};
+
+        std::mutex state_mutex; // Mutex for thread safety, guards the members below
+        std::condition_variable arrival_cv;
+        std::deque<std::pair<TimePoint, uint64_t>> arrivals; // Scheduled arrival time and index of queued fixed rate jobs
+        bool dispatch_done = false;
+        std::vector<double> latencies;
+        uint64_t failed = 0;
+        int unpinned_workers = 0;
+    };
+
+    // Reserves the next job index, false when no more jobs may be issued
+    static bool reserveJob(RunState& state, uint64_t& job_index)
+    {
+        job_index = state.issued.fetch_add(1);
+        return state.config.max_jobs == 0 || job_index < state.config.max_jobs;
+    }
+
+    void dispatchArrivals(RunState& state)
+    {
+        auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / state.config.arrival_rate));
+        TimePoint next_arrival = state.start;
+        uint64_t job_index = 0;
+        while(next_arrival < state.issue_deadline && reserveJob(state, job_index))
+        {
+            std::this_thread::sleep_until(next_arrival);
+            {
+                std::lock_guard<std::mutex> lock(state.state_mutex); // Lock the mutex for thread safety
+                state.arrivals.emplace_back(next_arrival, job_index);
+            }
+            state.arrival_cv.notify_one();
+            next_arrival += interval;
+        }
+        {
+            std::lock_guard<std::mutex> lock(state.state_mutex); // Lock the mutex for thread safety
+            state.dispatch_done = true;
+        }
+        state.arrival_cv.notify_all();
+    }
+
+    // Waits for the next job, returns false when the worker should stop.
+    // Queued jobs are drained for at most another run duration after issuing stopped.
+    bool nextJob(RunState& state, TimePoint& arrival, uint64_t& job_index)
+    {
+        if(state.config.mode == LoadTestMode::ClosedLoop)
+        {
+            arrival = std::chrono::steady_clock::now();
+            return arrival < state.issue_deadline && reserveJob(state, job_index);
+        }
+        auto drain_deadline = state.issue_deadline + (state.issue_deadline - state.start);
+        std::unique_lock<std::mutex> lock(state.state_mutex); // Lock the mutex for thread safety
+        state.arrival_cv.wait(lock, [&state]() { return !state.arrivals.empty() || state.dispatch_done; });
+        if(state.arrivals.empty() || std::chrono::steady_clock::now() > drain_deadline)
+        {
+            return false; // Nothing left, or the remaining jobs are dropped
+        }
+        arrival = state.arrivals.front().first;
+        job_index = state.arrivals.front().second;
+        state.arrivals.pop_front();
+        return true;
+    }
+
+    void runWorker(RunState& state, const std::string& patch_file_path)
+    {
+        std::vector<int> slice;
+        if(state.config.cpus_per_job > 0 && env_controller->AcquireCpuSlice(state.config.cpus_per_job, slice) != 0)
+        {
+            std::lock_guard<std::mutex> lock(state.state_mutex); // Lock the mutex for thread safety
+            state.unpinned_workers++;
+        }
+        {
+            ScopedCpuAffinity affinity(slice);
+            TimePoint arrival;
+            uint64_t job_index = 0;
+            while(nextJob(state, arrival, job_index))
+            {
+                const LoadTestPair& pair = input_pairs[job_index % input_pairs.size()];
+                bool ok = runJob(pair, patch_file_path);
+                double latency = std::chrono::duration<double>(std::chrono::steady_clock::now() - arrival).count();
+                std::lock_guard<std::mutex> lock(state.state_mutex); // Lock the mutex for thread safety
+                if(ok)
+                {
+                    state.latencies.push_back(latency);
+                }
+                else
+                {
+                    state.failed++;
+                }
+            }
+        }
+        if(!slice.empty())
+        {
+            env_controller->ReleaseCpuSlice(slice);
+        }
+    }
+
+    bool runJob(const LoadTestPair& pair, const std::string& patch_file_path)
+    {
+        auto wrapper = wrapper_factory();
+        AlgoEvalResult result;
+        bool finished = false;
+        return wrapper
+            && wrapper->SetAlgoEvalFilePath(pair.old_file_path, pair.new_file_path) == 0
+            && wrapper->SetAlgoEvalPatchPath(patch_file_path) == 0
+            && wrapper->StartEval() == 0
+            && wrapper->GetEvalResult(result) == 0
+            && result.IsEvalFinished(finished) == 0
+            && finished;
+    }
+
+    AlgoWrapperFactory wrapper_factory;
+    std::vector<LoadTestPair> input_pairs;
+    ExecEnvController* env_controller;
+};
+
+#endif // LOAD_TEST_H
@@ -0,0 +1,219 @@
+/*
+    Cache of preprocessed old-file structures (suffix arrays, hash tables, ...)
+
+    Engines that index the old file can build the index once and reuse it for
+    every new file diffed against the same base. Entries are keyed by the
+    index format tag of the wrapper and the MD5 of the old file, held in memory
+    (LRU, bounded by a byte budget) and optionally persisted to a directory,
+    from which they are memory-mapped instead of read.
+*/
+#ifndef OLD_INDEX_CACHE_H
+#define OLD_INDEX_CACHE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+#include <QFile>
+#include <QSaveFile>
+#include <QIODevice>
+#include <QDir>
+
+class OldIndex
+{
+public:
+    explicit OldIndex(std::vector<uint8_t>&& data) : owned_data(std::move(data)) {}
+    explicit OldIndex(std::unique_ptr<QFile> file, const uint8_t* mapped, size_t size)
+        : mapped_file(std::move(file)), mapped_data(mapped), mapped_size(size) {}
+    ~OldIndex() = default; // Destroying the QFile unmaps it
+    OldIndex(const OldIndex&) = delete;
+    OldIndex& operator=(const OldIndex&) = delete;
+
+    const uint8_t* Data() const { return mapped_file ? mapped_data : owned_data.data(); }
+    size_t Size() const { return mapped_file ? mapped_size : owned_data.size(); }
+    bool IsMapped() const { return mapped_file != nullptr; }
+
+private:
+    std::vector<uint8_t> owned_data;
+    std::unique_ptr<QFile> mapped_file;
+    const uint8_t* mapped_data = nullptr;
+    size_t mapped_size = 0;
+};
+
+class OldIndexCache
+{
+public:
+    static OldIndexCache& Instance()
+    {
+        static OldIndexCache cache;
+        return cache;
+    }
+
+    // Disabled by default so repeated runs of the same pair keep measuring the full cost
+    void SetEnabled(bool enabled)
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex); // Lock the mutex for thread safety
+        cache_enabled = enabled;
+    }
+    bool IsEnabled()
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex); // Lock the mutex for thread safety
+        return cache_enabled;
+    }
+
+    // Directory for persisted indexes, empty keeps the cache in memory only
+    int SetDiskDir(const std::string& dir_path)
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex); // Lock the mutex for thread safety
+        if(!dir_path.empty() && !QDir().mkpath(QString::fromStdString(dir_path)))
+        {
+            return -1; // Directory cannot be created
+        }
+        disk_dir = dir_path;
+        return 0; // Success
+    }
+
+    void SetMemoryBudget(uint64_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex); // Lock the mutex for thread safety
+        memory_budget = bytes;
+        evictLocked();
+    }
+
+    std::shared_ptr<const OldIndex> Find(const std::string& index_tag, const std::string& old_file_md5)
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex); // Lock the mutex for thread safety
+        if(!cache_enabled)
+        {
+            return nullptr;
+        }
+        std::string key = makeKey(index_tag, old_file_md5);
+        auto it = entries.find(key);
+        if(it != entries.end())
+        {
+            lru.splice(lru.begin(), lru, it->second.lru_pos); // Most recently used
+            return it->second.index;
+        }
+        auto index = mapFromDisk(key);
+        if(index)
+        {
+            insertLocked(key, index);
+        }
+        return index;
+    }
+
+    std::shared_ptr<const OldIndex> Store(const std::string& index_tag, const std::string& old_file_md5, std::vector<uint8_t>&& data)
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex); // Lock the mutex for thread safety
+        std::string key = makeKey(index_tag, old_file_md5);
+        if(cache_enabled && !disk_dir.empty())
+        {
+            writeToDisk(key, data);
+        }
+        auto index = std::make_shared<const OldIndex>(std::move(data));
+        if(cache_enabled)
+        {
+            insertLocked(key, index);
+        }
+        return index;
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex); // Lock the mutex for thread safety
+        entries.clear();
+        lru.clear();
+        memory_used = 0;
+    }
+
+private:
+    struct Entry
+    {
+        std::shared_ptr<const OldIndex> index;
+        std::list<std::string>::iterator lru_pos;
+    };
+
+    OldIndexCache() = default;
+
+    static std::string makeKey(const std::string& index_tag, const std::string& old_file_md5)
+    {
+        return index_tag + "_" + old_file_md5;
+    }
+
+    QString diskPath(const std::string& key) const
+    {
+        return QDir(QString::fromStdString(disk_dir)).absoluteFilePath(QString::fromStdString(key) + ".idx");
+    }
+
+    std::shared_ptr<const OldIndex> mapFromDisk(const std::string& key)
+    {
+        if(disk_dir.empty())
+        {
+            return nullptr;
+        }
+        auto file = std::make_unique<QFile>(diskPath(key));
+        if(!file->exists() || !file->open(QIODevice::ReadOnly) || file->size() == 0)
+        {
+            return nullptr;
+        }
+        uchar* mapped = file->map(0, file->size());
+        if(mapped == nullptr)
+        {
+            return nullptr; // Mapping failed
+        }
+        size_t size = static_cast<size_t>(file->size());
+        return std::make_shared<const OldIndex>(std::move(file), mapped, size);
+    }
+
+    void writeToDisk(const std::string& key, const std::vector<uint8_t>& data)
+    {
+        QSaveFile file(diskPath(key)); // Written to a temporary file and renamed on commit
+        if(!file.open(QIODevice::WriteOnly))
+        {
+            return; // Best effort, the in-memory entry still works
+        }
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<qint64>(data.size()));
+        file.commit();
+    }
+
+    void insertLocked(const std::string& key, const std::shared_ptr<const OldIndex>& index)
+    {
+        auto it = entries.find(key);
+        if(it != entries.end())
+        {
+            memory_used -= it->second.index->Size();
+            lru.erase(it->second.lru_pos);
+            entries.erase(it);
+        }
+        lru.push_front(key);
+        entries[key] = Entry{index, lru.begin()};
+        memory_used += index->Size();
+        evictLocked();
+    }
+
+    void evictLocked()
+    {
+        // Evicted indexes stay alive while an evaluation still holds them
+        while(memory_used > memory_budget && lru.size() > 1)
+        {
+            auto it = entries.find(lru.back());
+            memory_used -= it->second.index->Size();
+            entries.erase(it);
+            lru.pop_back();
+        }
+    }
+
+    bool cache_enabled = false;
+    std::string disk_dir;
+    uint64_t memory_budget = 1024ULL * 1024 * 1024; // Bytes of indexes kept in memory
+    uint64_t memory_used = 0;
+    std::map<std::string, Entry> entries;
+    std::list<std::string> lru; // Front is most recently used
+    std::mutex cache_mutex; // Mutex for thread safety
+};
+
+#endif // OLD_INDEX_CACHE_H
@@ -0,0 +1,389 @@
+/*
+    Prefetching input loader for batch runs
+
+    Reads and hashes the next input pairs in the background while the current
+    evaluation runs, so evaluations do not wait on the disk between jobs.
+    Pairs are handed out in order. At most `depth` pairs are loaded ahead, and
+    the loaded and loading pairs together stay within the memory budget (a
+    pair larger than the whole budget is loaded alone). Files are read with
+    io_uring when the build found liburing (DAE_HAVE_LIBURING) and the kernel
+    allows it at runtime, otherwise with plain reads on the loader threads.
+    The time the consumer waited for a pair is reported as stall time.
+*/
+#ifndef PREFETCH_LOADER_H
+#define PREFETCH_LOADER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+#include <QFile>
+#include <QIODevice>
+#include <QCryptographicHash>
+#include <QByteArrayView>
+
+#if defined(DAE_HAVE_LIBURING)
+#include <liburing.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+struct PrefetchConfig
+{
+    size_t depth = 0; // Pairs loaded ahead of the one being evaluated, 0 disables prefetching
+    uint64_t memory_budget = 1024ULL * 1024 * 1024; // Bytes of loaded and loading pairs
+    size_t threads = 2; // Loader threads
+    bool keep_data = true; // False when only the hashes are needed, the data is dropped after hashing
+};
+
+struct PrefetchedPair
+{
+    std::string old_file_path;
+    std::string new_file_path;
+    bool has_data = false; // old_data and new_data hold the files, see PrefetchConfig::keep_data
+    std::vector<uint8_t> old_data;
+    std::vector<uint8_t> new_data;
+    std::string old_file_md5;
+    std::string new_file_md5;
+    int status = -1; // 0 when both files were read and hashed
+};
+
+struct PrefetchStats
+{
+    uint64_t pairs = 0;
+    uint64_t bytes_read = 0;
+    double stall_seconds = 0.0; // Time Next() waited for a pair that was not loaded yet
+    double load_seconds = 0.0; // Summed over the loader threads
+    bool io_uring = false; // At least one file was read with io_uring
+};
+
+namespace prefetch_detail
+{
+
+inline int readFilePlain(const std::string& file_path, std::vector<uint8_t>& data)
+{
+    QFile file(QString::fromStdString(file_path));
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        return -1; // Failed to open the file
+    }
+    data.resize(static_cast<size_t>(file.size()));
+    qint64 total = 0;
+    while(total < static_cast<qint64>(data.size()))
+    {
+        qint64 got = file.read(reinterpret_cast<char*>(data.data()) + total, static_cast<qint64>(data.size()) - total);
+        if(got <= 0)
+        {
+            return -1; // Read error or the file shrank
+        }
+        total += got;
+    }
+    return 0; // Success
+}
+
+#if defined(DAE_HAVE_LIBURING)
+// Reads the whole file with up to QueueDepth chunk reads in flight. Returns 1
+// without reading when the kernel refuses io_uring (kernel.io_uring_disabled,
+// a seccomp filter), so the caller can fall back to plain reads.
+inline int readFileUring(const std::string& file_path, std::vector<uint8_t>& data)
+{
+    constexpr unsigned QueueDepth = 8;
+    constexpr size_t ChunkSize = 1024 * 1024;
+    struct Request
+    {
+        uint64_t offset;
+        size_t length;
+    };
+
+    struct io_uring ring;
+    if(io_uring_queue_init(QueueDepth, &ring, 0) != 0)
+    {
+        return 1; // io_uring not available at runtime
+    }
+    int fd = open(file_path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        io_uring_queue_exit(&ring);
+        return -1; // Failed to open the file
+    }
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0)
+    {
+        io_uring_queue_exit(&ring);
+        close(fd);
+        return -1; // Failed to get the file size
+    }
+    size_t size = static_cast<size_t>(file_stat.st_size);
+    data.resize(size);
+
+    Request requests[QueueDepth];
+    std::vector<Request*> free_requests;
+    for(auto& request : requests)
+    {
+        free_requests.push_back(&request);
+    }
+    auto queueRead = [&ring, fd, &data](Request* request) {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_read(sqe, fd, data.data() + request->offset, static_cast<unsigned>(request->length), request->offset);
+        io_uring_sqe_set_data(sqe, request);
+    };
+
+    int ret = 0;
+    size_t next_offset = 0;
+    unsigned in_flight = 0;
+    while(next_offset < size || in_flight > 0)
+    {
+        while(ret == 0 && next_offset < size && !free_requests.empty())
+        {
+            Request* request = free_requests.back();
+            free_requests.pop_back();
+            *request = Request{next_offset, std::min(ChunkSize, size - next_offset)};
+            queueRead(request);
+            next_offset += request->length;
+            in_flight++;
+        }
+        if(in_flight == 0)
+        {
+            break; // Failed before anything was queued
+        }
+        io_uring_submit(&ring);
+        io_uring_cqe* cqe = nullptr;
+        int wait_ret = 0;
+        do
+        {
+            wait_ret = io_uring_wait_cqe(&ring, &cqe);
+        } while(wait_ret == -EINTR);
+        if(wait_ret != 0)
+        {
+            ret = -1; // The ring failed, tearing it down below cancels the reads in flight
+            break;
+        }
+        auto* request = static_cast<Request*>(io_uring_cqe_get_data(cqe));
+        int result = cqe->res;
+        io_uring_cqe_seen(&ring, cqe);
+        in_flight--;
+        if(result <= 0 || ret != 0)
+        {
+            ret = -1; // Read error or the file shrank, drain the remaining reads
+            next_offset = size;
+            free_requests.push_back(request);
+            continue;
+        }
+        if(static_cast<size_t>(result) < request->length)
+        {
+            request->offset += static_cast<uint64_t>(result); // Short read, queue the rest
+            request->length -= static_cast<size_t>(result);
+            queueRead(request);
+            in_flight++;
+            continue;
+        }
+        free_requests.push_back(request);
+    }
+    io_uring_queue_exit(&ring);
+    close(fd);
+    return ret;
+}
+#endif
+
+// used_io_uring is set when io_uring read the file, false after a plain read
+inline int readFile(const std::string& file_path, std::vector<uint8_t>& data, bool& used_io_uring)
+{
+    used_io_uring = false;
+#if defined(DAE_HAVE_LIBURING)
+    int ret = readFileUring(file_path, data);
+    if(ret <= 0)
+    {
+        used_io_uring = true;
+        return ret;
+    }
+#endif
+    return readFilePlain(file_path, data);
+}
+
+inline std::string hashData(const std::vector<uint8_t>& data)
+{
+    QByteArrayView view(reinterpret_cast<const char*>(data.data()), static_cast<qsizetype>(data.size()));
+    return QCryptographicHash::hash(view, QCryptographicHash::Md5).toHex().toStdString();
+}
+
+} // namespace prefetch_detail
+
+class PrefetchLoader
+{
+public:
+    // pairs holds (old file, new file) paths in the order they are consumed
+    // The pair sizes are read once here, so workers do not stat files while holding the lock
+    PrefetchLoader(const std::vector<std::pair<std::string, std::string>>& pairs, const PrefetchConfig& config)
+        : input_pairs(pairs), config(config), slots(pairs.size()), reservations(pairs.size(), 0)
+    {
+        for(const auto& pair : input_pairs)
+        {
+            pair_sizes.push_back(statPairSize(pair));
+        }
+    }
+    ~PrefetchLoader()
+    {
+        Stop();
+    }
+    PrefetchLoader(const PrefetchLoader&) = delete;
+    PrefetchLoader& operator=(const PrefetchLoader&) = delete;
+
+    int Start()
+    {
+        std::lock_guard<std::mutex> lock(loader_mutex); // Lock the mutex for thread safety
+        if(!workers.empty() || config.depth == 0 || config.threads == 0)
+        {
+            return -1; // Already started or nothing to prefetch
+        }
+        for(size_t worker = 0; worker < config.threads; worker++)
+        {
+            workers.emplace_back([this]() { runWorker(); });
+        }
+        return 0; // Success
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(loader_mutex); // Lock the mutex for thread safety
+            stopping = true;
+        }
+        loader_cv.notify_all();
+        for(auto& worker : workers)
+        {
+            worker.join();
+        }
+        workers.clear();
+    }
+
+    // Hands out the next pair in order, blocking until it is loaded. The previous
+    // pair stops counting against the budget, so keep it only until the next call.
+    int Next(std::shared_ptr<const PrefetchedPair>& pair)
+    {
+        std::unique_lock<std::mutex> lock(loader_mutex); // Lock the mutex for thread safety
+        if(workers.empty() || next_out >= slots.size())
+        {
+            return -1; // Not started or no pairs left
+        }
+        if(next_out > 0)
+        {
+            reserved_bytes -= reservations[next_out - 1]; // The consumer is done with the previous pair
+            reservations[next_out - 1] = 0;
+        }
+        loader_cv.notify_all();
+        auto wait_start = std::chrono::steady_clock::now();
+        consumer_cv.wait(lock, [this]() { return slots[next_out] != nullptr; });
+        stats.stall_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - wait_start).count();
+        pair = std::move(slots[next_out]);
+        next_out++;
+        stats.pairs++;
+        return pair->status;
+    }
+
+    PrefetchStats GetStats()
+    {
+        std::lock_guard<std::mutex> lock(loader_mutex); // Lock the mutex for thread safety
+        return stats;
+    }
+
+private:
+    // Next pair a worker may load: inside the depth window and within the budget
+    bool canLoadNext() const
+    {
+        if(next_load >= input_pairs.size() || next_load >= next_out + config.depth)
+        {
+            return false;
+        }
+        return reserved_bytes == 0 || reserved_bytes + pair_sizes[next_load] <= config.memory_budget;
+    }
+
+    static uint64_t statPairSize(const std::pair<std::string, std::string>& pair)
+    {
+        std::error_code ec;
+        uint64_t old_size = std::filesystem::file_size(pair.first, ec);
+        uint64_t new_size = ec ? 0 : std::filesystem::file_size(pair.second, ec);
+        return ec ? 0 : old_size + new_size;
+    }
+
+    void runWorker()
+    {
+        for(;;)
+        {
+            size_t index = 0;
+            {
+                std::unique_lock<std::mutex> lock(loader_mutex); // Lock the mutex for thread safety
+                loader_cv.wait(lock, [this]() { return stopping || canLoadNext(); });
+                if(stopping)
+                {
+                    return;
+                }
+                index = next_load++;
+                reservations[index] = pair_sizes[index];
+                reserved_bytes += reservations[index];
+            }
+
+            auto load_start = std::chrono::steady_clock::now();
+            auto pair = std::make_shared<PrefetchedPair>();
+            pair->old_file_path = input_pairs[index].first;
+            pair->new_file_path = input_pairs[index].second;
+            bool old_io_uring = false;
+            bool new_io_uring = false;
+            if(prefetch_detail::readFile(pair->old_file_path, pair->old_data, old_io_uring) == 0
+                && prefetch_detail::readFile(pair->new_file_path, pair->new_data, new_io_uring) == 0)
+            {
+                pair->old_file_md5 = prefetch_detail::hashData(pair->old_data);
+                pair->new_file_md5 = prefetch_detail::hashData(pair->new_data);
+                pair->status = 0;
+            }
+            uint64_t bytes_read = pair->old_data.size() + pair->new_data.size();
+            pair->has_data = config.keep_data && pair->status == 0;
+            if(!pair->has_data)
+            {
+                pair->old_data = std::vector<uint8_t>();
+                pair->new_data = std::vector<uint8_t>();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(loader_mutex); // Lock the mutex for thread safety
+                if(!pair->has_data)
+                {
+                    reserved_bytes -= reservations[index]; // Only the hashes are kept
+                    reservations[index] = 0;
+                }
+                stats.bytes_read += bytes_read;
+                stats.io_uring = stats.io_uring || old_io_uring || new_io_uring;
+                stats.load_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - load_start).count();
+                slots[index] = std::move(pair);
+            }
+            consumer_cv.notify_all();
+            loader_cv.notify_all();
+        }
+    }
+
+    std::vector<std::pair<std::string, std::string>> input_pairs;
+    std::vector<uint64_t> pair_sizes; // Bytes of both files of each pair, 0 when they could not be read
+    PrefetchConfig config;
+    std::vector<std::shared_ptr<PrefetchedPair>> slots; // Loaded pairs not handed out yet
+    std::vector<uint64_t> reservations; // Bytes each pair counts against the budget
+    uint64_t reserved_bytes = 0;
+    size_t next_load = 0; // Next pair a worker picks up
+    size_t next_out = 0; // Next pair Next() hands out
+    bool stopping = false;
+    PrefetchStats stats;
+    std::vector<std::thread> workers;
+    std::mutex loader_mutex; // Mutex for thread safety, guards the members above
+    std::condition_variable loader_cv; // Workers wait for room in the window or budget
+    std::condition_variable consumer_cv; // Next() waits for its pair
+};
+
+#endif // PREFETCH_LOADER_H
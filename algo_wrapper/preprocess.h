@@ -0,0 +1,473 @@
+/*
+    Input preprocessing ahead of StartEval
+
+    A pipeline of stages transforms the old and the new input the same way
+    before they reach the algorithm, so any preprocessing can be combined with
+    any algorithm and the patch size benefit measured:
+
+    gunzip    Decompress gzip streams (needs zlib, DAE_HAVE_ZLIB)
+    unzip     Expand zip archives into their entries ordered by name (deflated entries need zlib)
+    bcj-x86   Turn relative x86 CALL/JMP rel32 targets into absolute addresses
+    bl-arm    Same for 32 bit ARM BL instructions
+    bl-arm64  Same for AArch64 BL instructions
+
+    The branch filters follow the idea of the xz BCJ filters: code that moved
+    by a constant offset changes every relative branch, absolute targets stay
+    identical and diff much better. Pipelines are written as stage names
+    joined by '+', e.g. "unzip+bcj-x86".
+*/
+#ifndef PREPROCESS_H
+#define PREPROCESS_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+
+#ifdef DAE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "base_algo_wrapper.h"
+#include "alloc_profiler.h"
+
+class BasePreprocessor
+{
+public:
+    BasePreprocessor() = default;
+    virtual ~BasePreprocessor() = default;
+
+    virtual std::string GetName() const = 0;
+    virtual int Process(const std::vector<uint8_t>& input, std::vector<uint8_t>& output) = 0;
+};
+
+namespace preprocess_detail
+{
+
+inline uint32_t readLE32(const uint8_t* data)
+{
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8)
+           | (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+inline uint16_t readLE16(const uint8_t* data)
+{
+    return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+inline void writeLE32(uint8_t* data, uint32_t value)
+{
+    data[0] = static_cast<uint8_t>(value);
+    data[1] = static_cast<uint8_t>(value >> 8);
+    data[2] = static_cast<uint8_t>(value >> 16);
+    data[3] = static_cast<uint8_t>(value >> 24);
+}
+
+#ifdef DAE_HAVE_ZLIB
+// window_bits as for inflateInit2: 16 + MAX_WBITS for gzip, -MAX_WBITS for raw deflate
+inline int inflateData(const uint8_t* data, size_t size, int window_bits, std::vector<uint8_t>& output, size_t& consumed)
+{
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if(inflateInit2(&stream, window_bits) != Z_OK)
+    {
+        return -1; // Failed to initialize zlib
+    }
+    stream.next_in = const_cast<Bytef*>(data);
+    stream.avail_in = static_cast<uInt>(std::min<size_t>(size, UINT32_MAX));
+    uint8_t buffer[64 * 1024];
+    int ret = Z_OK;
+    while(ret != Z_STREAM_END)
+    {
+        stream.next_out = buffer;
+        stream.avail_out = sizeof(buffer);
+        ret = inflate(&stream, Z_NO_FLUSH);
+        if(ret != Z_OK && ret != Z_STREAM_END)
+        {
+            inflateEnd(&stream);
+            return -1; // Corrupt or truncated stream
+        }
+        output.insert(output.end(), buffer, buffer + (sizeof(buffer) - stream.avail_out));
+    }
+    consumed = stream.total_in;
+    inflateEnd(&stream);
+    return 0; // Success
+}
+#endif
+
+} // namespace preprocess_detail
+
+class GunzipPreprocessor : public BasePreprocessor
+{
+public:
+    std::string GetName() const override { return "gunzip"; }
+
+    int Process(const std::vector<uint8_t>& input, std::vector<uint8_t>& output) override
+    {
+        output.clear();
+#ifdef DAE_HAVE_ZLIB
+        // Concatenated gzip members decompress to the concatenation of their contents
+        size_t offset = 0;
+        while(offset + 2 <= input.size() && input[offset] == 0x1f && input[offset + 1] == 0x8b)
+        {
+            size_t consumed = 0;
+            if(preprocess_detail::inflateData(input.data() + offset, input.size() - offset, 16 + MAX_WBITS, output, consumed) != 0)
+            {
+                return -1; // Corrupt gzip stream
+            }
+            offset += consumed;
+        }
+        return offset == 0 ? -1 : 0; // Not gzip when no member was found
+#else
+        (void)input;
+        return -1; // Built without zlib
+#endif
+    }
+};
+
+// Entries are emitted sorted by name as: name, NUL, 8 byte little endian size, data.
+// Zip64 archives and encrypted entries are not supported.
+class UnzipPreprocessor : public BasePreprocessor
+{
+public:
+    std::string GetName() const override { return "unzip"; }
+
+    int Process(const std::vector<uint8_t>& input, std::vector<uint8_t>& output) override
+    {
+        using preprocess_detail::readLE16;
+        using preprocess_detail::readLE32;
+        output.clear();
+
+        // The end of central directory record sits in the last 64KB + 22 bytes
+        constexpr size_t eocd_size = 22;
+        if(input.size() < eocd_size)
+        {
+            return -1; // Not a zip archive
+        }
+        size_t eocd = input.size() - eocd_size;
+        size_t search_end = input.size() > eocd_size + 0xFFFF ? input.size() - eocd_size - 0xFFFF : 0;
+        while(readLE32(&input[eocd]) != 0x06054b50)
+        {
+            if(eocd == search_end)
+            {
+                return -1; // No end of central directory record
+            }
+            eocd--;
+        }
+        uint16_t entry_count = readLE16(&input[eocd + 10]);
+        size_t central_offset = readLE32(&input[eocd + 16]);
+
+        struct ZipEntry
+        {
+            std::string name;
+            uint16_t method = 0;
+            uint16_t flags = 0;
+            size_t compressed_size = 0;
+            size_t size = 0;
+            size_t local_offset = 0;
+        };
+        std::vector<ZipEntry> entries;
+        size_t offset = central_offset;
+        for(uint16_t index = 0; index < entry_count; index++)
+        {
+            if(offset + 46 > input.size() || readLE32(&input[offset]) != 0x02014b50)
+            {
+                return -1; // Corrupt central directory
+            }
+            ZipEntry entry;
+            entry.flags = readLE16(&input[offset + 8]);
+            entry.method = readLE16(&input[offset + 10]);
+            entry.compressed_size = readLE32(&input[offset + 20]);
+            entry.size = readLE32(&input[offset + 24]);
+            uint16_t name_length = readLE16(&input[offset + 28]);
+            uint16_t extra_length = readLE16(&input[offset + 30]);
+            uint16_t comment_length = readLE16(&input[offset + 32]);
+            entry.local_offset = readLE32(&input[offset + 42]);
+            if(offset + 46 + name_length > input.size() || entry.compressed_size == 0xFFFFFFFF || entry.local_offset == 0xFFFFFFFF)
+            {
+                return -1; // Corrupt entry or Zip64
+            }
+            entry.name.assign(reinterpret_cast<const char*>(&input[offset + 46]), name_length);
+            entries.push_back(entry);
+            offset += 46 + name_length + extra_length + comment_length;
+        }
+        std::sort(entries.begin(), entries.end(), [](const ZipEntry& a, const ZipEntry& b) { return a.name < b.name; });
+
+        for(const auto& entry : entries)
+        {
+            if((entry.flags & 0x1) != 0)
+            {
+                return -1; // Encrypted entry
+            }
+            size_t local = entry.local_offset;
+            if(local + 30 > input.size() || readLE32(&input[local]) != 0x04034b50)
+            {
+                return -1; // Corrupt local header
+            }
+            size_t data_offset = local + 30 + readLE16(&input[local + 26]) + readLE16(&input[local + 28]);
+            if(data_offset + entry.compressed_size > input.size())
+            {
+                return -1; // Truncated entry
+            }
+
+            std::vector<uint8_t> data;
+            if(entry.method == 0)
+            {
+                data.assign(input.begin() + static_cast<std::ptrdiff_t>(data_offset),
+                            input.begin() + static_cast<std::ptrdiff_t>(data_offset + entry.compressed_size));
+            }
+            else if(entry.method == 8)
+            {
+#ifdef DAE_HAVE_ZLIB
+                size_t consumed = 0;
+                // The declared size is untrusted; deflate cannot expand more than about 1032:1
+                constexpr uint64_t max_deflate_ratio = 1032;
+                data.reserve(static_cast<size_t>(std::min<uint64_t>(entry.size, static_cast<uint64_t>(entry.compressed_size) * max_deflate_ratio)));
+                if(preprocess_detail::inflateData(&input[data_offset], entry.compressed_size, -MAX_WBITS, data, consumed) != 0)
+                {
+                    return -1; // Corrupt deflate stream
+                }
+#else
+                return -1; // Built without zlib
+#endif
+            }
+            else
+            {
+                return -1; // Unsupported compression method
+            }
+
+            output.insert(output.end(), entry.name.begin(), entry.name.end());
+            output.push_back(0);
+            uint64_t data_size = data.size();
+            for(int shift = 0; shift < 64; shift += 8)
+            {
+                output.push_back(static_cast<uint8_t>(data_size >> shift));
+            }
+            output.insert(output.end(), data.begin(), data.end());
+        }
+        return 0; // Success
+    }
+};
+
+// x86 E8 (CALL) and E9 (JMP) with a rel32 whose high byte is 0x00 or 0xFF,
+// i.e. a plausible near target, get the displacement replaced by the absolute target
+class X86BranchPreprocessor : public BasePreprocessor
+{
+public:
+    std::string GetName() const override { return "bcj-x86"; }
+
+    int Process(const std::vector<uint8_t>& input, std::vector<uint8_t>& output) override
+    {
+        output = input;
+        size_t pos = 0;
+        while(pos + 5 <= output.size())
+        {
+            uint8_t opcode = output[pos];
+            uint8_t high = output[pos + 4];
+            if((opcode == 0xE8 || opcode == 0xE9) && (high == 0x00 || high == 0xFF))
+            {
+                uint32_t relative = preprocess_detail::readLE32(&output[pos + 1]);
+                uint32_t absolute = relative + static_cast<uint32_t>(pos + 5);
+                preprocess_detail::writeLE32(&output[pos + 1], absolute);
+                pos += 5;
+            }
+            else
+            {
+                pos++;
+            }
+        }
+        return 0; // Success
+    }
+};
+
+// ARM BL with the always condition (0xEB in the top byte), 4 byte aligned little endian code
+class ArmBranchPreprocessor : public BasePreprocessor
+{
+public:
+    std::string GetName() const override { return "bl-arm"; }
+
+    int Process(const std::vector<uint8_t>& input, std::vector<uint8_t>& output) override
+    {
+        output = input;
+        for(size_t pos = 0; pos + 4 <= output.size(); pos += 4)
+        {
+            if(output[pos + 3] != 0xEB)
+            {
+                continue;
+            }
+            uint32_t offset = (preprocess_detail::readLE32(&output[pos]) & 0x00FFFFFF) << 2;
+            uint32_t absolute = ((offset + static_cast<uint32_t>(pos + 8)) >> 2) & 0x00FFFFFF;
+            preprocess_detail::writeLE32(&output[pos], 0xEB000000 | absolute);
+        }
+        return 0; // Success
+    }
+};
+
+// AArch64 BL (opcode 100101 in the top six bits), imm26 in units of 4 bytes
+class Arm64BranchPreprocessor : public BasePreprocessor
+{
+public:
+    std::string GetName() const override { return "bl-arm64"; }
+
+    int Process(const std::vector<uint8_t>& input, std::vector<uint8_t>& output) override
+    {
+        output = input;
+        for(size_t pos = 0; pos + 4 <= output.size(); pos += 4)
+        {
+            uint32_t instruction = preprocess_detail::readLE32(&output[pos]);
+            if((instruction & 0xFC000000) != 0x94000000)
+            {
+                continue;
+            }
+            uint32_t absolute = ((instruction & 0x03FFFFFF) + static_cast<uint32_t>(pos >> 2)) & 0x03FFFFFF;
+            preprocess_detail::writeLE32(&output[pos], 0x94000000 | absolute);
+        }
+        return 0; // Success
+    }
+};
+
+using PreprocessorFactory = std::function<std::unique_ptr<BasePreprocessor>()>;
+
+class PreprocessorRegistry
+{
+public:
+    static PreprocessorRegistry& Instance()
+    {
+        static PreprocessorRegistry registry;
+        return registry;
+    }
+
+    int Register(const std::string& name, PreprocessorFactory factory)
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex); // Lock the mutex for thread safety
+        if(name.empty() || !factory || factories.count(name) != 0)
+        {
+            return -1; // Invalid or duplicate registration
+        }
+        factories[name] = std::move(factory);
+        return 0; // Success
+    }
+
+    std::unique_ptr<BasePreprocessor> Create(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex); // Lock the mutex for thread safety
+        auto it = factories.find(name);
+        if(it == factories.end())
+        {
+            return nullptr; // Not registered
+        }
+        return it->second();
+    }
+
+    std::vector<std::string> GetNames()
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex); // Lock the mutex for thread safety
+        std::vector<std::string> names;
+        for(const auto& pair : factories)
+        {
+            names.push_back(pair.first);
+        }
+        return names;
+    }
+
+private:
+    PreprocessorRegistry()
+    {
+        factories["gunzip"] = []() { return std::make_unique<GunzipPreprocessor>(); };
+        factories["unzip"] = []() { return std::make_unique<UnzipPreprocessor>(); };
+        factories["bcj-x86"] = []() { return std::make_unique<X86BranchPreprocessor>(); };
+        factories["bl-arm"] = []() { return std::make_unique<ArmBranchPreprocessor>(); };
+        factories["bl-arm64"] = []() { return std::make_unique<Arm64BranchPreprocessor>(); };
+    }
+
+    std::map<std::string, PreprocessorFactory> factories;
+    std::mutex registry_mutex; // Mutex for thread safety
+};
+
+class PreprocessPipeline
+{
+public:
+    PreprocessPipeline() = default;
+    ~PreprocessPipeline() = default;
+
+    // Builds the pipeline from stage names joined by '+'; "" and "none" mean no preprocessing
+    int Build(const std::string& spec)
+    {
+        stages.clear();
+        if(spec.empty() || spec == "none")
+        {
+            return 0; // Success
+        }
+        std::stringstream stream(spec);
+        std::string name;
+        while(std::getline(stream, name, '+'))
+        {
+            auto stage = PreprocessorRegistry::Instance().Create(name);
+            if(!stage)
+            {
+                stages.clear();
+                return -1; // Unknown stage
+            }
+            stages.push_back(std::move(stage));
+        }
+        return 0; // Success
+    }
+
+    bool IsEmpty() const { return stages.empty(); }
+
+    std::string GetName() const
+    {
+        std::string name;
+        for(const auto& stage : stages)
+        {
+            name += (name.empty() ? "" : "+") + stage->GetName();
+        }
+        return name;
+    }
+
+    // Runs every stage on data in place. stage_stats gets one entry per stage and
+    // accumulates across calls, so running the old and then the new input sums both.
+    int Run(std::vector<uint8_t>& data, std::vector<AlgoPreprocessStage>& stage_stats)
+    {
+        stage_stats.resize(stages.size());
+        for(size_t index = 0; index < stages.size(); index++)
+        {
+            AlgoPreprocessStage& stats = stage_stats[index];
+            bool first_run = stats.name.empty();
+            stats.name = stages[index]->GetName();
+            std::vector<uint8_t> output;
+            AlgoEvalAllocStats alloc_stats;
+            bool measured = false;
+            auto start = std::chrono::steady_clock::now();
+            {
+                // Profiles this thread only; fails when this thread is already being profiled
+                ScopedAllocProfile alloc_profile(true);
+                measured = alloc_profile.IsActive();
+                if(stages[index]->Process(data, output) != 0)
+                {
+                    return -1; // Stage failed
+                }
+                alloc_profile.Finish(alloc_stats);
+            }
+            stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            stats.memory_measured = measured && (first_run || stats.memory_measured);
+            stats.peak_memory = std::max(stats.peak_memory, alloc_stats.peak_live_bytes);
+            stats.input_bytes += data.size();
+            stats.output_bytes += output.size();
+            data.swap(output);
+        }
+        return 0; // Success
+    }
+
+private:
+    std::vector<std::unique_ptr<BasePreprocessor>> stages;
+};
+
+#endif // PREPROCESS_H
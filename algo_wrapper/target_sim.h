@@ -0,0 +1,402 @@
+/*
+    Constrained target simulation for patch apply
+
+    Models an embedded OTA device: a hard heap cap, the old image and the patch
+    streamed from flash, and the new image written at a limited bandwidth. The
+    I/O bandwidth is modeled, not enforced, so a simulation runs at host speed
+    and the device time is projected from the bytes moved.
+*/
+#ifndef TARGET_SIM_H
+#define TARGET_SIM_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#include <QFile>
+#include <QIODevice>
+#include <QCryptographicHash>
+#include <QByteArrayView>
+
+#include "base_algo_wrapper.h"
+#include "algo_registry.h"
+
+struct TargetDeviceModel
+{
+    uint64_t heap_cap = 16ULL * 1024 * 1024; // Bytes of heap available to the apply
+    uint64_t flash_read_bandwidth = 20ULL * 1024 * 1024; // Bytes per second
+    uint64_t write_bandwidth = 5ULL * 1024 * 1024; // Bytes per second
+    uint64_t read_chunk_size = 4096; // Largest single read issued to flash
+    double flash_read_latency = 0.0001; // Seconds per read request
+    double cpu_scale = 1.0; // Device CPU time / host CPU time
+
+    // The bandwidths divide the modeled times and the chunk size bounds every read, none may be 0
+    bool IsValid() const
+    {
+        return flash_read_bandwidth > 0 && write_bandwidth > 0 && read_chunk_size > 0
+               && flash_read_latency >= 0.0 && cpu_scale > 0.0;
+    }
+};
+
+// Heap with a hard cap. Allocations that would exceed the cap fail with nullptr,
+// the way a device allocator does, so engines can be routed through it via
+// their custom allocator hooks.
+class CappedHeap
+{
+public:
+    explicit CappedHeap(uint64_t cap) : heap_cap(cap) {}
+    ~CappedHeap() = default;
+    CappedHeap(const CappedHeap&) = delete;
+    CappedHeap& operator=(const CappedHeap&) = delete;
+
+    void* Allocate(size_t size)
+    {
+        std::lock_guard<std::mutex> lock(heap_mutex); // Lock the mutex for thread safety
+        if(heap_live + size > heap_cap)
+        {
+            heap_failed = true;
+            return nullptr; // Over the cap
+        }
+        // Keep the size in front of the block so Free() can account for it
+        auto* block = static_cast<uint64_t*>(std::malloc(size + sizeof(uint64_t)));
+        if(block == nullptr)
+        {
+            heap_failed = true;
+            return nullptr; // Host out of memory
+        }
+        block[0] = size;
+        heap_live += size;
+        if(heap_live > heap_peak)
+        {
+            heap_peak = heap_live;
+        }
+        return block + 1;
+    }
+
+    void Free(void* ptr)
+    {
+        if(ptr == nullptr)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(heap_mutex); // Lock the mutex for thread safety
+        auto* block = static_cast<uint64_t*>(ptr) - 1;
+        heap_live -= block[0];
+        std::free(block);
+    }
+
+    uint64_t GetCap() const { return heap_cap; }
+    uint64_t GetPeak() const { return heap_peak; }
+    uint64_t GetLive() const { return heap_live; }
+    bool HasFailed() const { return heap_failed; } // True once any allocation hit the cap
+
+private:
+    uint64_t heap_cap;
+    uint64_t heap_live = 0;
+    uint64_t heap_peak = 0;
+    bool heap_failed = false;
+    std::mutex heap_mutex; // Mutex for thread safety
+};
+
+// Random access reader over a file on the modeled flash
+class FlashFileReader
+{
+public:
+    FlashFileReader(const std::string& file_path, const TargetDeviceModel& model)
+        : file(QString::fromStdString(file_path)), model(model) {}
+    ~FlashFileReader() = default;
+
+    int Open()
+    {
+        return file.open(QIODevice::ReadOnly) ? 0 : -1;
+    }
+
+    uint64_t GetSize() const
+    {
+        return static_cast<uint64_t>(file.size());
+    }
+
+    // Reads up to size bytes at offset, split into device sized requests
+    int64_t Read(uint64_t offset, uint8_t* buffer, size_t size)
+    {
+        if(model.read_chunk_size == 0)
+        {
+            return -1; // Invalid device model, no request could make progress
+        }
+        if(!file.seek(static_cast<qint64>(offset)))
+        {
+            return -1; // Offset out of range
+        }
+        size_t total = 0;
+        while(total < size)
+        {
+            size_t request = std::min<size_t>(size - total, static_cast<size_t>(model.read_chunk_size));
+            qint64 got = file.read(reinterpret_cast<char*>(buffer + total), static_cast<qint64>(request));
+            if(got < 0)
+            {
+                return -1; // Read error
+            }
+            read_requests++;
+            read_bytes += static_cast<uint64_t>(got);
+            total += static_cast<size_t>(got);
+            if(static_cast<size_t>(got) < request)
+            {
+                break; // End of file
+            }
+        }
+        if(trace != nullptr)
+        {
+            trace->Record(offset, total);
+        }
+        return static_cast<int64_t>(total);
+    }
+
+    void SetTrace(ReadOffsetTrace* trace) // Records the offset and size of every Read(), owned by the caller
+    {
+        this->trace = trace;
+    }
+
+    uint64_t GetReadBytes() const { return read_bytes; }
+    uint64_t GetReadRequests() const { return read_requests; }
+    double GetModeledSeconds() const
+    {
+        return static_cast<double>(read_bytes) / static_cast<double>(model.flash_read_bandwidth)
+               + static_cast<double>(read_requests) * model.flash_read_latency;
+    }
+
+private:
+    QFile file;
+    TargetDeviceModel model;
+    uint64_t read_bytes = 0;
+    uint64_t read_requests = 0;
+    ReadOffsetTrace* trace = nullptr;
+};
+
+// Sequential writer for the reconstructed image. The output is hashed rather
+// than stored so the simulation does not need room for the new image.
+class FlashImageWriter
+{
+public:
+    explicit FlashImageWriter(const TargetDeviceModel& model) : md5(QCryptographicHash::Md5), model(model) {}
+    ~FlashImageWriter() = default;
+
+    int Write(const uint8_t* data, size_t size)
+    {
+        md5.addData(QByteArrayView(reinterpret_cast<const char*>(data), static_cast<qsizetype>(size)));
+        write_bytes += size;
+        return 0; // Success
+    }
+
+    uint64_t GetWriteBytes() const { return write_bytes; }
+    std::string GetMD5() const { return md5.result().toHex().toStdString(); }
+    double GetModeledSeconds() const
+    {
+        return static_cast<double>(write_bytes) / static_cast<double>(model.write_bandwidth);
+    }
+
+private:
+    QCryptographicHash md5;
+    TargetDeviceModel model;
+    uint64_t write_bytes = 0;
+};
+
+// Everything a wrapper may touch while applying a patch on the modeled device
+struct ConstrainedApplyEnv
+{
+    CappedHeap& heap;
+    FlashFileReader& old_reader;
+    FlashFileReader& patch_reader;
+    FlashImageWriter& new_writer;
+};
+
+struct ApplySimResult
+{
+    bool success = false;
+    bool output_verified = false; // Output MD5 matched the expected new image
+    bool hit_cap = false; // At least one allocation was refused, the engine may have adapted
+    uint64_t heap_cap = 0;
+    uint64_t heap_peak = 0;
+    uint64_t old_read_bytes = 0;
+    uint64_t patch_read_bytes = 0;
+    uint64_t write_bytes = 0;
+    AlgoIoAccessSummary old_read_access; // Filled when old reads are traced
+    double host_seconds = 0.0; // Measured apply time on this machine
+    double projected_seconds = 0.0; // Host time scaled to the device plus modeled I/O
+};
+
+struct MinRamResult
+{
+    bool found = false;
+    uint64_t min_heap = 0; // Smallest cap, at the search granularity, that applied successfully
+    ApplySimResult at_min_heap;
+    int attempts = 0;
+};
+
+class ConstrainedApplySimulator
+{
+public:
+    explicit ConstrainedApplySimulator(const TargetDeviceModel& model) : model(model) {}
+    ~ConstrainedApplySimulator() = default;
+
+    // Trace how the wrapper reads the old image, summarized in ApplySimResult::old_read_access
+    void SetTraceOldReads(bool enabled)
+    {
+        trace_old_reads = enabled;
+    }
+
+    int Run(const AlgoWrapperFactory& factory,
+            const std::string& old_file_path,
+            const std::string& patch_file_path,
+            const std::string& expected_md5,
+            uint64_t heap_cap,
+            ApplySimResult& result) const
+    {
+        if(!model.IsValid())
+        {
+            return -1; // Invalid device model
+        }
+        auto wrapper = factory ? factory() : nullptr;
+        if(!wrapper || !wrapper->IsConstrainedApplySupported())
+        {
+            return -1; // Wrapper cannot apply on the modeled device
+        }
+
+        CappedHeap heap(heap_cap);
+        FlashFileReader old_reader(old_file_path, model);
+        FlashFileReader patch_reader(patch_file_path, model);
+        FlashImageWriter new_writer(model);
+        if(old_reader.Open() != 0 || patch_reader.Open() != 0)
+        {
+            return -1; // Failed to open the inputs
+        }
+        ReadOffsetTrace old_read_trace;
+        if(trace_old_reads)
+        {
+            old_reader.SetTrace(&old_read_trace);
+        }
+        ConstrainedApplyEnv env{heap, old_reader, patch_reader, new_writer};
+
+        auto start = std::chrono::steady_clock::now();
+        int ret = wrapper->ApplyPatchConstrained(env);
+        auto finish = std::chrono::steady_clock::now();
+
+        result = ApplySimResult();
+        result.success = (ret == 0);
+        result.hit_cap = heap.HasFailed();
+        result.output_verified = result.success && (expected_md5.empty() || new_writer.GetMD5() == expected_md5);
+        result.heap_cap = heap_cap;
+        result.heap_peak = heap.GetPeak();
+        result.old_read_bytes = old_reader.GetReadBytes();
+        result.patch_read_bytes = patch_reader.GetReadBytes();
+        result.write_bytes = new_writer.GetWriteBytes();
+        if(trace_old_reads)
+        {
+            old_read_trace.Summarize(result.old_read_access);
+        }
+        result.host_seconds = std::chrono::duration<double>(finish - start).count();
+        result.projected_seconds = result.host_seconds * model.cpu_scale
+                                   + old_reader.GetModeledSeconds()
+                                   + patch_reader.GetModeledSeconds()
+                                   + new_writer.GetModeledSeconds();
+        return 0; // Simulation ran, see result.success
+    }
+
+    // Binary search for the smallest heap cap the apply succeeds with. Engines may
+    // size their buffers from the cap, so the peak of an unconstrained run is only
+    // used as the upper bound.
+    int FindMinimumRam(const AlgoWrapperFactory& factory,
+                       const std::string& old_file_path,
+                       const std::string& patch_file_path,
+                       const std::string& expected_md5,
+                       uint64_t upper_bound,
+                       uint64_t granularity,
+                       MinRamResult& result) const
+    {
+        result = MinRamResult();
+        if(granularity == 0)
+        {
+            return -1; // Invalid granularity
+        }
+
+        ApplySimResult upper;
+        if(Run(factory, old_file_path, patch_file_path, expected_md5, upper_bound, upper) != 0)
+        {
+            return -1; // Simulation could not run
+        }
+        result.attempts++;
+        if(!upper.output_verified)
+        {
+            return 0; // Does not fit even at the upper bound
+        }
+
+        uint64_t low = 0; // Known failing (nothing fits in zero bytes)
+        uint64_t high = roundUp(upper.heap_peak, granularity); // Known succeeding
+        ApplySimResult best = upper;
+        if(high < upper_bound)
+        {
+            ApplySimResult at_peak;
+            if(Run(factory, old_file_path, patch_file_path, expected_md5, high, at_peak) != 0)
+            {
+                return -1; // Simulation could not run
+            }
+            result.attempts++;
+            if(at_peak.output_verified)
+            {
+                best = at_peak;
+            }
+            else
+            {
+                high = upper_bound;
+            }
+        }
+        else
+        {
+            high = upper_bound;
+        }
+
+        while(high - low > granularity)
+        {
+            uint64_t mid = roundUp(low + (high - low) / 2, granularity);
+            if(mid >= high)
+            {
+                break;
+            }
+            ApplySimResult attempt;
+            if(Run(factory, old_file_path, patch_file_path, expected_md5, mid, attempt) != 0)
+            {
+                return -1; // Simulation could not run
+            }
+            result.attempts++;
+            if(attempt.output_verified)
+            {
+                high = mid;
+                best = attempt;
+            }
+            else
+            {
+                low = mid;
+            }
+        }
+
+        result.found = true;
+        result.min_heap = high;
+        result.at_min_heap = best;
+        return 0; // Success
+    }
+
+private:
+    static uint64_t roundUp(uint64_t value, uint64_t granularity)
+    {
+        return (value + granularity - 1) / granularity * granularity;
+    }
+
+    TargetDeviceModel model;
+    bool trace_old_reads = false;
+};
+
+#endif // TARGET_SIM_H
@@ -0,0 +1,1556 @@
+#include "eval_cli.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QStringList>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QByteArray>
+
+#include <map>
+#include <vector>
+#include <string>
+#include <memory>
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+
+#include "algo_registry.h"
+#include "eval_baseline.h"
+#include "target_sim.h"
+#include "exec_env.h"
+#include "old_index_cache.h"
+#include "delta_chain.h"
+#include "load_test.h"
+#include "preprocess.h"
+#include "input_profile.h"
+#include "algo_race.h"
+#include "prefetch_loader.h"
+
+namespace
+{
+
+enum CliExitCode
+{
+    CLI_EXIT_OK = 0,
+    CLI_EXIT_REGRESSION = 1, // Used by compare mode to gate upgrades
+    CLI_EXIT_ERROR = 2
+};
+
+struct BenchPair
+{
+    std::string old_file_path;
+    std::string new_file_path;
+};
+
+struct BenchSet
+{
+    std::vector<std::string> algo_names;
+    std::vector<BenchPair> pairs;
+    int runs = 5; // Repetitions per algorithm and pair
+    AlgoEvalIoMode io_mode = AlgoEvalIoMode::File;
+    std::vector<int> cpus; // CPUs evaluations are pinned to, empty for no pinning
+    EvalProbeOptions probes; // Allocation and I/O profiling during StartEval
+    std::vector<std::string> preprocess = {""}; // Pipelines every algorithm runs with, "" for raw inputs
+    bool analyze_inputs = false; // Profile each pair before evaluating it
+    std::string schedule_history; // Win history file, when set the scheduler orders and skips algorithms
+    AlgoScheduleConfig schedule;
+    PrefetchConfig prefetch; // depth 0 loads each pair only when its evaluations start
+};
+
+int parseIoMode(const QString& name, AlgoEvalIoMode& io_mode)
+{
+    if(name == "file")
+    {
+        io_mode = AlgoEvalIoMode::File;
+        return 0;
+    }
+    if(name == "memory")
+    {
+        io_mode = AlgoEvalIoMode::Memory;
+        return 0;
+    }
+    return -1; // Unknown I/O mode
+}
+
+// Bench set format: {"algorithms": ["mock"], "runs": 5, "io_mode": "file", "preprocess": ["none", "gunzip"],
+//                    "pairs": [{"old": "a.bin", "new": "b.bin"}]}
+// Relative file paths are resolved against the directory of the bench set file.
+int loadBenchSet(const QString& file_path, BenchSet& bench_set)
+{
+    QFile file(file_path);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        return -1; // Failed to open the file
+    }
+    QJsonParseError parse_error;
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parse_error);
+    if(parse_error.error != QJsonParseError::NoError || !doc.isObject())
+    {
+        return -1; // Malformed bench set
+    }
+
+    QDir base_dir = QFileInfo(file_path).absoluteDir();
+    QJsonObject root = doc.object();
+    bench_set = BenchSet();
+    for(const QJsonValue& algo_value : root.value("algorithms").toArray())
+    {
+        bench_set.algo_names.push_back(algo_value.toString().toStdString());
+    }
+    for(const QJsonValue& pair_value : root.value("pairs").toArray())
+    {
+        QJsonObject pair_obj = pair_value.toObject();
+        BenchPair pair;
+        pair.old_file_path = QDir::cleanPath(base_dir.absoluteFilePath(pair_obj.value("old").toString())).toStdString();
+        pair.new_file_path = QDir::cleanPath(base_dir.absoluteFilePath(pair_obj.value("new").toString())).toStdString();
+        bench_set.pairs.push_back(pair);
+    }
+    bench_set.runs = root.value("runs").toInt(bench_set.runs);
+    if(root.contains("preprocess"))
+    {
+        bench_set.preprocess.clear();
+        for(const QJsonValue& preprocess_value : root.value("preprocess").toArray())
+        {
+            bench_set.preprocess.push_back(preprocess_value.toString().toStdString());
+        }
+    }
+    if(parseIoMode(root.value("io_mode").toString("file"), bench_set.io_mode) != 0)
+    {
+        return -1; // Unknown I/O mode
+    }
+
+    if(bench_set.algo_names.empty() || bench_set.pairs.empty() || bench_set.preprocess.empty() || bench_set.runs <= 0)
+    {
+        return -1; // Nothing to evaluate
+    }
+    return 0; // Success
+}
+
+int readWholeFile(const std::string& file_path, std::vector<uint8_t>& data)
+{
+    QFile file(QString::fromStdString(file_path));
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        return -1; // Failed to open the file
+    }
+    QByteArray content = file.readAll();
+    data.assign(content.constData(), content.constData() + content.size());
+    return 0; // Success
+}
+
+int writeWholeFile(const std::string& file_path, const std::vector<uint8_t>& data)
+{
+    QFile file(QString::fromStdString(file_path));
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return -1; // Failed to open the file
+    }
+    if(file.write(reinterpret_cast<const char*>(data.data()), static_cast<qint64>(data.size())) != static_cast<qint64>(data.size()))
+    {
+        return -1; // Failed to write the file
+    }
+    return 0; // Success
+}
+
+std::string makeTempFilePath(const std::string& file_name)
+{
+    std::error_code ec;
+    auto tmp_dir = std::filesystem::temp_directory_path(ec);
+    if(ec)
+    {
+        tmp_dir = std::filesystem::current_path();
+    }
+    return (tmp_dir / ("DiffAlgoEval_" + std::to_string(QCoreApplication::applicationPid()) + "_" + file_name)).string();
+}
+
+void removeTempFile(const std::string& file_path)
+{
+    std::error_code ec;
+    std::filesystem::remove(file_path, ec); // Best effort
+}
+
+// Copies the inputs from the prefetched pair when it holds them, reads them otherwise
+int loadPairData(const BenchPair& pair, const PrefetchedPair* prefetched, std::vector<uint8_t>& old_data, std::vector<uint8_t>& new_data)
+{
+    if(prefetched != nullptr && prefetched->has_data)
+    {
+        old_data = prefetched->old_data;
+        new_data = prefetched->new_data;
+        return 0; // Success
+    }
+    if(readWholeFile(pair.old_file_path, old_data) != 0 || readWholeFile(pair.new_file_path, new_data) != 0)
+    {
+        return -1; // Failed to read the inputs
+    }
+    return 0; // Success
+}
+
+// prefetched, when not null, holds the hashes and possibly the contents of pair loaded ahead of time
+int runSingleEval(const std::string& algo_name, const BenchPair& pair, AlgoEvalIoMode io_mode, const std::string& preprocess,
+                  const std::vector<int>& cpus, const EvalProbeOptions& probes, const PrefetchedPair* prefetched, AlgoEvalResult& result)
+{
+    auto wrapper = AlgoRegistry::Instance().Create(algo_name);
+    PreprocessPipeline pipeline;
+    if(!wrapper || pipeline.Build(preprocess) != 0)
+    {
+        return -1; // Algorithm or preprocessing stage not registered
+    }
+
+    // Preprocessing runs ahead of the evaluation and is reported per stage, not as part of the duration
+    std::vector<uint8_t> old_data, new_data;
+    std::vector<AlgoPreprocessStage> preprocess_stages;
+    BenchPair eval_pair = pair;
+    if(!pipeline.IsEmpty())
+    {
+        if(loadPairData(pair, prefetched, old_data, new_data) != 0
+            || pipeline.Run(old_data, preprocess_stages) != 0 || pipeline.Run(new_data, preprocess_stages) != 0)
+        {
+            return -1; // Failed to load or preprocess the inputs
+        }
+        if(io_mode == AlgoEvalIoMode::File)
+        {
+            // File mode measures reading the inputs, so the preprocessed inputs go back to disk
+            std::string suffix = "." + pipeline.GetName();
+            eval_pair.old_file_path = makeTempFilePath("old_" + std::filesystem::path(pair.old_file_path).filename().string() + suffix);
+            eval_pair.new_file_path = makeTempFilePath("new_" + std::filesystem::path(pair.new_file_path).filename().string() + suffix);
+            if(writeWholeFile(eval_pair.old_file_path, old_data) != 0 || writeWholeFile(eval_pair.new_file_path, new_data) != 0)
+            {
+                removeTempFile(eval_pair.old_file_path);
+                removeTempFile(eval_pair.new_file_path);
+                return -1; // Failed to write the preprocessed inputs
+            }
+        }
+    }
+
+    // Memory mode loads both inputs up front so only the diff itself is timed
+    QByteArray patch_data;
+    if(io_mode == AlgoEvalIoMode::Memory)
+    {
+        if(!wrapper->IsMemoryEvalSupported())
+        {
+            return -1; // Wrapper only works on files
+        }
+        // Prefetched raw inputs are evaluated in place, without a copy
+        const std::vector<uint8_t>* old_input = &old_data;
+        const std::vector<uint8_t>* new_input = &new_data;
+        if(pipeline.IsEmpty() && prefetched != nullptr && prefetched->has_data)
+        {
+            old_input = &prefetched->old_data;
+            new_input = &prefetched->new_data;
+        }
+        else if(pipeline.IsEmpty() && loadPairData(pair, nullptr, old_data, new_data) != 0)
+        {
+            return -1; // Failed to load the inputs
+        }
+        AlgoEvalBuffer old_buffer{old_input->data(), old_input->size()};
+        AlgoEvalBuffer new_buffer{new_input->data(), new_input->size()};
+        patch_data.reserve(static_cast<qsizetype>(new_input->size()));
+        auto patch_sink = [&patch_data](const uint8_t* data, size_t size) {
+            patch_data.append(reinterpret_cast<const char*>(data), static_cast<qsizetype>(size));
+            return 0;
+        };
+        if(wrapper->SetAlgoEvalBuffer(old_buffer, new_buffer, patch_sink) != 0)
+        {
+            return -1; // Failed to set the evaluation buffers
+        }
+    }
+    else if(wrapper->SetAlgoEvalFilePath(eval_pair.old_file_path, eval_pair.new_file_path) != 0)
+    {
+        return -1; // Failed to set the evaluation files
+    }
+    if(pipeline.IsEmpty() && prefetched != nullptr && prefetched->status == 0
+        && wrapper->SetAlgoEvalInputHashes(prefetched->old_file_md5, prefetched->new_file_md5) != 0)
+    {
+        return -1; // Failed to pass the prefetched hashes
+    }
+
+    int ret = RunEvalInEnv(*wrapper, cpus, NoiseThresholds(), result, probes);
+    if(!pipeline.IsEmpty() && io_mode == AlgoEvalIoMode::File)
+    {
+        removeTempFile(eval_pair.old_file_path);
+        removeTempFile(eval_pair.new_file_path);
+    }
+    if(ret != 0)
+    {
+        return -1; // Evaluation failed
+    }
+    return result.SetEvalPreprocess(pipeline.GetName(), preprocess_stages);
+}
+
+std::string formatBytes(uint64_t bytes)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    if(bytes >= 1024ULL * 1024)
+    {
+        out << static_cast<double>(bytes) / (1024.0 * 1024.0) << " MiB";
+    }
+    else if(bytes >= 1024ULL)
+    {
+        out << static_cast<double>(bytes) / 1024.0 << " KiB";
+    }
+    else
+    {
+        out << bytes << " B";
+    }
+    return out.str();
+}
+
+void printAllocStats(const std::string& algo_name, const AlgoEvalAllocStats& alloc_stats)
+{
+    std::cout << algo_name << ": " << alloc_stats.allocations << " allocations, " << alloc_stats.frees << " frees, "
+              << formatBytes(alloc_stats.bytes_allocated) << " allocated, peak live " << formatBytes(alloc_stats.peak_live_bytes)
+              << std::endl << "  sizes:";
+    for(int size_class = 0; size_class < AlgoEvalAllocStats::SizeClassCount; size_class++)
+    {
+        std::cout << " " << AlgoEvalAllocStats::GetSizeClassName(size_class) << ":" << alloc_stats.size_classes[size_class];
+    }
+    std::cout << std::endl << "  " << (alloc_stats.malloc_tracked ? "new/delete and malloc" : "new/delete only")
+              << ", evaluating thread only, profiling overhead ~" << std::fixed << std::setprecision(4)
+              << alloc_stats.overhead_seconds << " s" << std::endl;
+}
+
+void printPreprocessStages(const std::string& algo_name, const std::string& preprocess, const std::vector<AlgoPreprocessStage>& stages)
+{
+    std::cout << algo_name << " [" << preprocess << "]:";
+    for(const auto& stage : stages)
+    {
+        std::cout << " " << stage.name << " " << std::fixed << std::setprecision(3) << stage.seconds << " s, "
+                  << formatBytes(stage.input_bytes) << " -> " << formatBytes(stage.output_bytes);
+        std::cout << ", peak heap " << (stage.memory_measured ? formatBytes(stage.peak_memory) : std::string("not measured"));
+        std::cout << ";";
+    }
+    std::cout << std::endl;
+}
+
+void printIoStats(const std::string& algo_name, const AlgoEvalIoStats& io_stats)
+{
+    std::cout << algo_name << ": read " << formatBytes(io_stats.rchar) << " in " << io_stats.syscr << " calls ("
+              << formatBytes(io_stats.read_bytes) << " from storage), wrote " << formatBytes(io_stats.wchar) << " in "
+              << io_stats.syscw << " calls (" << formatBytes(io_stats.write_bytes) << " to storage)" << std::endl;
+}
+
+void printAccessSummary(const std::string& label, const AlgoIoAccessSummary& access)
+{
+    if(access.reads == 0 && access.dropped_reads == 0)
+    {
+        std::cout << label << ": no reads traced" << std::endl;
+        return;
+    }
+    std::cout << label << ": " << access.reads << " reads, " << formatBytes(access.bytes_read) << ", "
+              << std::fixed << std::setprecision(1) << access.GetSequentialRatio() * 100.0 << "% sequential, working set "
+              << formatBytes(access.working_set_bytes);
+    if(access.dropped_reads > 0)
+    {
+        std::cout << " (" << access.dropped_reads << " reads not traced)";
+    }
+    std::cout << std::endl;
+    if(access.random_reads > 0)
+    {
+        std::cout << "  seeks:";
+        for(int seek_class = 0; seek_class < AlgoIoAccessSummary::SeekClassCount; seek_class++)
+        {
+            std::cout << " " << AlgoIoAccessSummary::GetSeekClassName(seek_class) << ":" << access.seek_classes[seek_class];
+        }
+        std::cout << std::endl;
+    }
+}
+
+// Per run details beyond the compared metrics: noise warnings, index reuse, allocations, I/O, preprocessing
+void printRunDetails(const std::string& algo_name, AlgoEvalResult& result)
+{
+    AlgoEvalEnv env;
+    result.GetEvalEnv(env);
+    for(const auto& warning : env.warnings)
+    {
+        std::cerr << "warning: " << algo_name << ": " << warning << std::endl;
+    }
+    AlgoOldIndexState index_state = AlgoOldIndexState::None;
+    std::chrono::duration<double> build_duration, incremental_duration;
+    if(result.GetEvalOldIndex(index_state, build_duration, incremental_duration) == 0
+        && index_state != AlgoOldIndexState::None && OldIndexCache::Instance().IsEnabled())
+    {
+        std::cout << algo_name << ": old index " << AlgoEvalResult::GetOldIndexStateName(index_state)
+                  << std::fixed << std::setprecision(3) << ", build " << build_duration.count()
+                  << " s, incremental " << incremental_duration.count() << " s" << std::endl;
+    }
+    AlgoEvalAllocStats alloc_stats;
+    result.GetEvalAllocStats(alloc_stats);
+    if(alloc_stats.profiled)
+    {
+        printAllocStats(algo_name, alloc_stats);
+    }
+    AlgoEvalIoStats io_stats;
+    result.GetEvalIoStats(io_stats);
+    if(io_stats.profiled)
+    {
+        printIoStats(algo_name, io_stats);
+    }
+    AlgoIoAccessSummary old_read_access;
+    result.GetEvalOldReadAccess(old_read_access);
+    if(old_read_access.traced)
+    {
+        printAccessSummary(algo_name + ": old reads", old_read_access);
+    }
+    std::string preprocess;
+    std::vector<AlgoPreprocessStage> preprocess_stages;
+    result.GetEvalPreprocess(preprocess, preprocess_stages);
+    if(!preprocess_stages.empty())
+    {
+        printPreprocessStages(algo_name, preprocess, preprocess_stages);
+    }
+}
+
+// Profiles a pair as the algorithms will see it, after preprocessing. The hashes of
+// the inputs as the algorithms see them are returned too, they identify the cases.
+int analyzePair(const BenchPair& pair, const std::string& preprocess, const PrefetchedPair* prefetched, AlgoInputProfile& profile,
+                std::string& old_file_md5, std::string& new_file_md5)
+{
+    PreprocessPipeline pipeline;
+    std::vector<uint8_t> old_data, new_data;
+    std::vector<AlgoPreprocessStage> unused_stages;
+    if(pipeline.Build(preprocess) != 0)
+    {
+        return -1; // Unknown pipeline
+    }
+    if(pipeline.IsEmpty() && prefetched != nullptr && prefetched->has_data)
+    {
+        old_file_md5 = prefetched->old_file_md5;
+        new_file_md5 = prefetched->new_file_md5;
+        return InputProfiler::Analyze(prefetched->old_data.data(), prefetched->old_data.size(),
+                                      prefetched->new_data.data(), prefetched->new_data.size(), profile);
+    }
+    if(loadPairData(pair, prefetched, old_data, new_data) != 0)
+    {
+        return -1; // Unreadable inputs
+    }
+    if(!pipeline.IsEmpty() && (pipeline.Run(old_data, unused_stages) != 0 || pipeline.Run(new_data, unused_stages) != 0))
+    {
+        return -1; // Failed to preprocess the inputs
+    }
+    old_file_md5 = prefetch_detail::hashData(old_data);
+    new_file_md5 = prefetch_detail::hashData(new_data);
+    return InputProfiler::Analyze(old_data.data(), old_data.size(), new_data.data(), new_data.size(), profile);
+}
+
+void printInputProfile(const BenchPair& pair, const std::string& preprocess, const AlgoInputProfile& profile)
+{
+    std::cout << std::filesystem::path(pair.old_file_path).filename().string() << " -> "
+              << std::filesystem::path(pair.new_file_path).filename().string() << (preprocess.empty() ? "" : " [" + preprocess + "]")
+              << ": similarity " << std::fixed << std::setprecision(1) << profile.similarity * 100.0 << "%, entropy "
+              << std::setprecision(2) << profile.old_entropy << " -> " << profile.new_entropy << " bits/byte, "
+              << AlgoInputProfile::GetContentKindName(profile.old_kind) << " -> " << AlgoInputProfile::GetContentKindName(profile.new_kind)
+              << " (" << InputProfiler::GetProfileKey(profile) << ", " << std::setprecision(3) << profile.seconds << " s)" << std::endl;
+}
+
+int runBenchSet(const BenchSet& bench_set, EvalBaseline& results)
+{
+    AlgoWinHistory history;
+    bool scheduling = !bench_set.schedule_history.empty();
+    if(scheduling && QFileInfo::exists(QString::fromStdString(bench_set.schedule_history))
+        && history.LoadFromFile(bench_set.schedule_history) != 0)
+    {
+        std::cerr << "Failed to load the win history " << bench_set.schedule_history << std::endl;
+        return -1;
+    }
+    AlgoScheduler scheduler(history, bench_set.schedule);
+
+    // Loads and hashes the next pairs while the current one is evaluated
+    std::unique_ptr<PrefetchLoader> loader;
+    if(bench_set.prefetch.depth > 0)
+    {
+        std::vector<std::pair<std::string, std::string>> paths;
+        for(const auto& pair : bench_set.pairs)
+        {
+            paths.emplace_back(pair.old_file_path, pair.new_file_path);
+        }
+        PrefetchConfig prefetch = bench_set.prefetch;
+        bool needs_data = bench_set.io_mode == AlgoEvalIoMode::Memory || bench_set.analyze_inputs || scheduling;
+        for(const auto& preprocess : bench_set.preprocess)
+        {
+            needs_data = needs_data || !preprocess.empty();
+        }
+        prefetch.keep_data = needs_data; // File mode without preprocessing only uses the hashes
+        loader = std::make_unique<PrefetchLoader>(paths, prefetch);
+        if(loader->Start() != 0)
+        {
+            std::cerr << "Failed to start the input prefetcher" << std::endl;
+            return -1;
+        }
+    }
+    auto batch_start = std::chrono::steady_clock::now();
+
+    for(const auto& pair : bench_set.pairs)
+    {
+        std::shared_ptr<const PrefetchedPair> prefetched;
+        if(loader && loader->Next(prefetched) != 0)
+        {
+            std::cerr << "Failed to load " << pair.old_file_path << " -> " << pair.new_file_path << std::endl;
+            return -1;
+        }
+        for(const auto& preprocess : bench_set.preprocess)
+        {
+            AlgoInputProfile profile;
+            std::string old_file_md5, new_file_md5;
+            std::vector<std::string> algo_names = bench_set.algo_names;
+            if(bench_set.analyze_inputs || scheduling)
+            {
+                if(analyzePair(pair, preprocess, prefetched.get(), profile, old_file_md5, new_file_md5) != 0)
+                {
+                    std::cerr << "Input analysis failed: " << pair.old_file_path << " -> " << pair.new_file_path << std::endl;
+                    return -1;
+                }
+                printInputProfile(pair, preprocess, profile);
+            }
+            AlgoSchedulePlan plan;
+            if(scheduling)
+            {
+                scheduler.Plan(profile, bench_set.algo_names, plan);
+                if(plan.exploring)
+                {
+                    std::cout << "  exploring: running every algorithm" << std::endl;
+                }
+                for(const auto& skipped : plan.skipped)
+                {
+                    std::cout << "  skipped " << skipped.first << ": " << skipped.second << std::endl;
+                    results.AddSkipped(skipped.first, AlgoEvalResult::GetEvalIoModeName(bench_set.io_mode), preprocess, old_file_md5, new_file_md5);
+                }
+                algo_names = plan.algo_names;
+            }
+
+            std::string winner;
+            double winner_patch_size = 0.0;
+            for(const auto& algo_name : algo_names)
+            {
+                double patch_size_sum = 0.0;
+                for(int run = 0; run < bench_set.runs; ++run)
+                {
+                    AlgoEvalResult result;
+                    uint64_t patch_size = 0;
+                    if(runSingleEval(algo_name, pair, bench_set.io_mode, preprocess, bench_set.cpus, bench_set.probes, prefetched.get(), result) != 0
+                        || (profile.analyzed && result.SetEvalInputProfile(profile) != 0)
+                        || result.GetEvalPatchSize(patch_size) != 0
+                        || results.AddResult(algo_name, result) != 0)
+                    {
+                        std::cerr << "Evaluation failed: " << algo_name << (preprocess.empty() ? "" : " [" + preprocess + "]")
+                                  << " " << pair.old_file_path << " -> " << pair.new_file_path << std::endl;
+                        return -1;
+                    }
+                    printRunDetails(algo_name, result);
+                    patch_size_sum += static_cast<double>(patch_size);
+                }
+                double mean_patch_size = patch_size_sum / static_cast<double>(bench_set.runs);
+                if(winner.empty() || mean_patch_size < winner_patch_size)
+                {
+                    winner = algo_name;
+                    winner_patch_size = mean_patch_size;
+                }
+            }
+            // Only a full contest between several engines says anything about which one wins
+            if(scheduling && plan.full_run && algo_names.size() > 1)
+            {
+                history.RecordWin(InputProfiler::GetProfileKey(profile), winner);
+            }
+        }
+    }
+    if(loader)
+    {
+        PrefetchStats stats = loader->GetStats();
+        double batch_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batch_start).count();
+        std::cout << "prefetch" << (stats.io_uring ? " (io_uring)" : "") << ": " << stats.pairs << " pairs, "
+                  << formatBytes(stats.bytes_read) << " in " << std::fixed << std::setprecision(3) << stats.load_seconds
+                  << " s, stalled " << stats.stall_seconds << " s of " << batch_seconds << " s" << std::endl;
+    }
+    if(scheduling && history.SaveToFile(bench_set.schedule_history) != 0)
+    {
+        std::cerr << "Failed to save the win history " << bench_set.schedule_history << std::endl;
+        return -1;
+    }
+    return 0; // Success
+}
+
+// Accepts plain byte counts or K/M/G suffixed values, e.g. "16M"
+int parseByteSize(const QString& text, uint64_t& bytes)
+{
+    QString value = text.trimmed().toUpper();
+    uint64_t multiplier = 1;
+    if(value.endsWith('K'))
+    {
+        multiplier = 1024ULL;
+    }
+    else if(value.endsWith('M'))
+    {
+        multiplier = 1024ULL * 1024;
+    }
+    else if(value.endsWith('G'))
+    {
+        multiplier = 1024ULL * 1024 * 1024;
+    }
+    if(multiplier != 1)
+    {
+        value.chop(1);
+    }
+    bool ok = false;
+    double number = value.toDouble(&ok);
+    if(!ok || number <= 0.0)
+    {
+        return -1; // Invalid size
+    }
+    double scaled = number * static_cast<double>(multiplier);
+    if(scaled < 1.0)
+    {
+        return -1; // Truncates to 0 bytes
+    }
+    bytes = static_cast<uint64_t>(scaled);
+    return 0; // Success
+}
+
+std::string makeTempPatchPath(const std::string& algo_name)
+{
+    return makeTempFilePath(algo_name + ".patch");
+}
+
+const char* metricChangeName(MetricChange change)
+{
+    switch(change)
+    {
+    case MetricChange::Improved:
+        return "improved";
+    case MetricChange::Regressed:
+        return "REGRESSED";
+    default:
+        return "ok";
+    }
+}
+
+// QCommandLineParser::process() exits with 1 on a bad option, which CI would read as a regression.
+// Returns 0 to run the mode, 1 when help or the version was printed, -1 on a bad command line.
+int parseModeArguments(QCommandLineParser& parser, const QStringList& arguments, const char* mode)
+{
+    QCommandLineOption help_option = parser.addHelpOption();
+    QCommandLineOption version_option = parser.addVersionOption();
+    if(!parser.parse(arguments))
+    {
+        std::cerr << mode << ": " << parser.errorText().toStdString() << std::endl;
+        return -1;
+    }
+    if(parser.isSet(help_option))
+    {
+        std::cout << parser.helpText().toStdString();
+        return 1;
+    }
+    if(parser.isSet(version_option))
+    {
+        std::cout << QCoreApplication::applicationName().toStdString() << " "
+                  << QCoreApplication::applicationVersion().toStdString() << std::endl;
+        return 1;
+    }
+    return 0; // Success
+}
+
+void printComparisons(const std::vector<CaseComparison>& comparisons)
+{
+    for(const auto& comparison : comparisons)
+    {
+        std::cout << comparison.algo_name << " [" << comparison.io_mode
+                  << (comparison.preprocess.empty() ? "" : ", " + comparison.preprocess)
+                  << (comparison.index_cache ? ", index cache" : "") << "] " << comparison.old_file_md5.substr(0, 8)
+                  << " -> " << comparison.new_file_md5.substr(0, 8) << std::endl;
+        if(!comparison.in_baseline)
+        {
+            std::cout << "  no baseline" << std::endl;
+            continue;
+        }
+        if(comparison.skipped)
+        {
+            std::cout << "  skipped by the scheduler" << std::endl;
+            continue;
+        }
+        if(!comparison.in_current)
+        {
+            std::cout << "  missing from this run" << std::endl;
+            continue;
+        }
+        if(comparison.cpu_model_changed)
+        {
+            std::cout << "  note: baseline was recorded on a different CPU model" << std::endl;
+        }
+        if(comparison.noisy_samples > 0)
+        {
+            std::cout << "  note: " << comparison.noisy_samples << " sample(s) measured under noisy conditions" << std::endl;
+        }
+        for(const auto& metric : comparison.metrics)
+        {
+            std::cout << "  " << std::left << std::setw(12) << metric.metric << std::right << std::fixed
+                      << std::setprecision(3) << std::setw(16) << metric.baseline_mean
+                      << std::setw(16) << metric.current_mean
+                      << std::setprecision(1) << std::setw(9) << metric.relative_change * 100.0 << "%"
+                      << "  p=" << std::setprecision(4) << metric.p_value
+                      << "  " << metricChangeName(metric.change) << std::endl;
+        }
+    }
+}
+
+int runCompareMode(const QStringList& arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Run a bench set and compare it against a stored baseline.");
+    QCommandLineOption bench_set_option("bench-set", "Bench set description (JSON).", "file");
+    QCommandLineOption baseline_option("baseline", "Baseline results (JSON).", "file");
+    QCommandLineOption update_option("update-baseline", "Write the current results as the new baseline.");
+    QCommandLineOption runs_option("runs", "Override the number of runs per case.", "n");
+    QCommandLineOption io_mode_option("io-mode", "Measure the file or memory path (overrides the bench set).", "file|memory");
+    QCommandLineOption cpus_option("cpus", "Pin evaluations to these CPUs, e.g. 2-3.", "list");
+    QCommandLineOption time_option("time-threshold", "Tolerated relative slowdown (default 0.20).", "ratio");
+    QCommandLineOption memory_option("memory-threshold", "Tolerated relative memory growth (default 0.10).", "ratio");
+    QCommandLineOption patch_option("patch-threshold", "Tolerated relative patch size growth (default 0.05).", "ratio");
+    QCommandLineOption alpha_option("alpha", "Significance level of the t-test (default 0.05).", "p");
+    QCommandLineOption index_cache_option("index-cache", "Reuse old file indexes across runs and pairs with the same base.");
+    QCommandLineOption index_dir_option("index-cache-dir", "Persist old file indexes in this directory (implies --index-cache).", "dir");
+    QCommandLineOption profile_alloc_option("profile-alloc", "Count heap allocations during each evaluation.");
+    QCommandLineOption preprocess_option("preprocess", "Comma separated preprocessing pipelines, e.g. none,gunzip+bcj-x86 (overrides the bench set).", "pipelines");
+    QCommandLineOption profile_io_option("profile-io", "Record the process I/O bytes and syscalls of each evaluation.");
+    QCommandLineOption trace_reads_option("trace-reads", "Trace the old input reads of wrappers that report them.");
+    QCommandLineOption analyze_option("analyze", "Estimate similarity, entropy and content type of each pair before evaluating it.");
+    QCommandLineOption schedule_option("schedule", "Order and skip algorithms per pair from this win history, which is updated (implies --analyze).", "file");
+    QCommandLineOption schedule_top_option("schedule-top", "With --schedule, run only the n likeliest winners once a profile has enough history.", "n");
+    QCommandLineOption prefetch_option("prefetch", "Load and hash up to n pairs ahead while evaluating (default 0, off).", "n");
+    QCommandLineOption prefetch_budget_option("prefetch-budget", "Memory the prefetched pairs may use (default 1G).", "size");
+    parser.addOptions({bench_set_option, baseline_option, update_option, runs_option, io_mode_option, cpus_option,
+                       time_option, memory_option, patch_option, alpha_option, index_cache_option, index_dir_option,
+                       profile_alloc_option, preprocess_option, profile_io_option, trace_reads_option,
+                       analyze_option, schedule_option, schedule_top_option, prefetch_option, prefetch_budget_option});
+    int parse_ret = parseModeArguments(parser, arguments, "compare");
+    if(parse_ret != 0)
+    {
+        return parse_ret > 0 ? CLI_EXIT_OK : CLI_EXIT_ERROR;
+    }
+
+    if(!parser.isSet(bench_set_option) || !parser.isSet(baseline_option))
+    {
+        std::cerr << "compare: --bench-set and --baseline are required" << std::endl;
+        return CLI_EXIT_ERROR;
+    }
+
+    BenchSet bench_set;
+    if(loadBenchSet(parser.value(bench_set_option), bench_set) != 0)
+    {
+        std::cerr << "compare: failed to load bench set" << std::endl;
+        return CLI_EXIT_ERROR;
+    }
+    if(parser.isSet(runs_option))
+    {
+        bench_set.runs = parser.value(runs_option).toInt();
+        if(bench_set.runs <= 0)
+        {
+            std::cerr << "compare: invalid --runs" << std::endl;
+            return CLI_EXIT_ERROR;
+        }
+    }
+
+    if(parser.isSet(io_mode_option) && parseIoMode(parser.value(io_mode_option), bench_set.io_mode) != 0)
+    {
+        std::cerr << "compare: invalid --io-mode" << std::endl;
+        return CLI_EXIT_ERROR;
+    }
+
+    if(parser.isSet(cpus_option))
+    {
+        ExecEnvController env_controller;
+        bench_set.cpus = ExecEnvController::ParseCpuList(parser.value(cpus_option).toStdString());
+        if(env_controller.SetCpuSet(bench_set.cpus) != 0)
+        {
+            std::cerr << "compare: invalid --cpus" << std::endl;
+            return CLI_EXIT_ERROR;
+        }
+    }
+
+    bench_set.probes.profile_allocations = parser.isSet(profile_alloc_option);
+    bench_set.probes.profile_io = parser.isSet(profile_io_option);
+    bench_set.probes.trace_old_reads = parser.isSet(trace_reads_option);
+    bench_set.analyze_inputs = parser.isSet(analyze_option);
+    bench_set.schedule_history = parser.value(schedule_option).toStdString();
+    if(!bench_set.schedule_history.empty() && parser.isSet(update_option))
+    {
+        std::cerr << "compare: --schedule skips runs and cannot record a baseline, drop --update-baseline" << std::endl;
+        return CLI_EXIT_ERROR;
+    }
+    if(parser.isSet(schedule_top_option))
+    {
+        bool ok = false;
+        int keep_top = parser.value(schedule_top_option).toInt(&ok);
+        if(!ok || keep_top <= 0)
+        {
+            std::cerr << "compare: invalid --schedule-top" << std::endl;
+            return CLI_EXIT_ERROR;
+        }
+        bench_set.schedule.keep_top = static_cast<size_t>(keep_top);
+    }
+    if(parser.isSet(prefetch_option))
+    {
+        bool ok = false;
+        int depth = parser.value(prefetch_option).toInt(&ok);
+        if(!ok || depth < 0)
+        {
+            std::cerr << "compare: invalid --prefetch" << std::endl;
+            return CLI_EXIT_ERROR;
+        }
+        bench_set.prefetch.depth = static_cast<size_t>(depth);
+    }
+    if(bench_set.prefetch.depth > 0 && bench_set.probes.profile_io)
+    {
+        // The loader threads read while the evaluation runs, the process-wide I/O counters would include them
+        std::cerr << "compare: --prefetch cannot be combined with --profile-io" << std::endl;
+        return CLI_EXIT_ERROR;
+    }
+    if(parser.isSet(prefetch_budget_option) && parseByteSize(parser.value(prefetch_budget_option), bench_set.prefetch.memory_budget) != 0)
+    {
+        std::cerr << "compare: invalid --prefetch-budget" << std::endl;
+        return CLI_EXIT_ERROR;
+    }
+    if(parser.isSet(preprocess_option))
+    {
+        bench_set.preprocess.clear();
+        for(const QString& preprocess : parser.value(preprocess_option).split(","))
+        {
+            bench_set.preprocess.push_back(preprocess.trimmed().toStdString());
+        }
+    }
+    for(const auto& preprocess : bench_set.preprocess)
+    {
+        PreprocessPipeline pipeline;
+        if(pipeline.Build(preprocess) != 0)
+        {
+            std::cerr << "compare: unknown preprocessing pipeline '" << preprocess << "'" << std::endl;
+            return CLI_EXIT_ERROR;
+        }
+    }
+
+    if(parser.isSet(index_cache_option) || parser.isSet(index_dir_option))
+    {
+        OldIndexCache::Instance().SetEnabled(true);
+        if(parser.isSet(index_dir_option) && OldIndexCache::Instance().SetDiskDir(parser.value(index_dir_option).toStdString()) != 0)
+        {
+            std::cerr << "compare: invalid --index-cache-dir" << std::endl;
+            return CLI_EXIT_ERROR;
+        }
+    }
+
+    RegressionThresholds thresholds;
+    const std::vector<std::pair<QCommandLineOption*, double*>> threshold_options = {
+        {&time_option, &thresholds.duration},
+        {&memory_option, &thresholds.memory},
+        {&patch_option, &thresholds.patch_size},
+        {&alpha_option, &thresholds.alpha},
+    };
+    for(const auto& threshold_option : threshold_options)
+    {
+        if(parser.isSet(*threshold_option.first))
+        {
+            bool ok = false;
+            *threshold_option.second = parser.value(*threshold_option.first).toDouble(&ok);
+            if(!ok || *threshold_option.second < 0.0)
+            {
+                std::cerr << "compare: invalid --" << threshold_option.first->names().first().toStdString() << std::endl;
+                return CLI_EXIT_ERROR;
+            }
+        }
+    }
+
+    std::string baseline_path = parser.value(baseline_option).toStdString();
+    EvalBaseline baseline;
+    bool has_baseline = QFileInfo::exists(parser.value(baseline_option));
+    if(has_baseline && baseline.LoadFromFile(baseline_path) != 0)
+    {
+        std::cerr << "compare: failed to load baseline " << baseline_path << std::endl;
+        return CLI_EXIT_ERROR;
+    }
+    if(!has_baseline && !parser.isSet(update_option))
+    {
+        std::cerr << "compare: baseline " << baseline_path << " does not exist, use --update-baseline to record it" << std::endl;
+        return CLI_EXIT_ERROR;
+    }
+
+    EvalBaseline current;
+    if(runBenchSet(bench_set, current) != 0)
+    {
+        return CLI_EXIT_ERROR;
+    }
+
+    int exit_code = CLI_EXIT_OK;
+    if(has_baseline)
+    {
+        std::vector<CaseComparison> comparisons;
+        RegressionGate gate(thresholds);
+        gate.Compare(baseline, current, comparisons);
+        printComparisons(comparisons);
+        if(RegressionGate::HasRegression(comparisons))
+        {
+            std::cout << "Regression detected" << std::endl;
+            exit_code = CLI_EXIT_REGRESSION;
+        }
+        size_t missing = RegressionGate::CountMissingCases(comparisons);
+        if(missing > 0)
+        {
+            std::cout << missing << " baseline case(s) missing from this run" << std::endl;
+            exit_code = CLI_EXIT_REGRESSION;
+        }
+    }
+
+    if(parser.isSet(update_option))
+    {
+        if(current.SaveToFile(baseline_path) != 0)
+        {
+            std::cerr << "compare: failed to write baseline " << baseline_path << std::endl;
+            return CLI_EXIT_ERROR;
+        }
+        std::cout << "Baseline written to " << baseline_path << std::endl;
+    }
+    return exit_code;
+}
+
+// Device model options shared by the modes that project apply time
+struct DeviceModelOptions
+{
+    QCommandLineOption heap_option{"heap-cap", "Device heap available to the apply (default 16M).", "size"};
+    QCommandLineOption read_bw_option{"read-bandwidth", "Flash read bandwidth per second (default 20M).", "size"};
+    QCommandLineOption write_bw_option{"write-bandwidth", "Write bandwidth per second (default 5M).", "size"};
+    QCommandLineOption chunk_option{"read-chunk", "Largest single flash read (default 4K).", "size"};
+    QCommandLineOption cpu_option{"cpu-scale", "Device CPU time relative to this host (default 1.0).", "factor"};
+
+    void AddTo(QCommandLineParser& parser) const
+    {
+        parser.addOptions({heap_option, read_bw_option, write_bw_option, chunk_option, cpu_option});
+    }
+
+    int Read(const QCommandLineParser& parser, const char* mode, TargetDeviceModel& model) const
+    {
+        const std::vector<std::pair<const QCommandLineOption*, uint64_t*>> size_options = {
+            {&heap_option, &model.heap_cap},
+            {&read_bw_option, &model.flash_read_bandwidth},
+            {&write_bw_option, &model.write_bandwidth},
+            {&chunk_option, &model.read_chunk_size},
+        };
+        for(const auto& size_option : size_options)
+        {
+            if(parser.isSet(*size_option.first) && parseByteSize(parser.value(*size_option.first), *size_option.second) != 0)
+            {
+                std::cerr << mode << ": invalid --" << size_option.first->names().first().toStdString() << std::endl;
+                return -1;
+            }
+        }
+        if(parser.isSet(cpu_option))
+        {
+            bool ok = false;
+            model.cpu_scale = parser.value(cpu_option).toDouble(&ok);
+            if(!ok || model.cpu_scale <= 0.0)
+            {
+                std::cerr << mode << ": invalid --cpu-scale" << std::endl;
+                return -1;
+            }
+        }
+        if(!model.IsValid())
+        {
+            std::cerr << mode << ": invalid device model" << std::endl;
+            return -1;
+        }
+        return 0; // Success
+    }
+};
+
+int runSimulateApplyMode(const QStringList& arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Simulate patch apply on a memory and bandwidth constrained device.");
+    QCommandLineOption algo_option("algo", "Comma separated algorithm names.", "names");
+    QCommandLineOption old_option("old", "Old image.", "file");
+    QCommandLineOption new_option("new", "New image.", "file");
+    DeviceModelOptions device_options;
+    QCommandLineOption max_heap_option("max-heap", "Upper bound of the minimum RAM search (default 1G).", "size");
+    QCommandLineOption granularity_option("granularity", "Resolution of the minimum RAM search (default 4K).", "size");
+    QCommandLineOption trace_reads_option("trace-reads", "Trace how the old image is read during generation and apply.");
+    parser.addOptions({algo_option, old_option, new_option, max_heap_option, granularity_option, trace_reads_option});
+    device_options.AddTo(parser);
+    int parse_ret = parseModeArguments(parser, arguments, "simulate-apply");
+    if(parse_ret != 0)
+    {
+        return parse_ret > 0 ? CLI_EXIT_OK : CLI_EXIT_ERROR;
+    }
+
+    if(!parser.isSet(algo_option) || !parser.isSet(old_option) || !parser.isSet(new_option))
+    {
+        std::cerr << "simulate-apply: --algo, --old and --new are required" << std::endl;
+        return CLI_EXIT_ERROR;
+    }
+
+    TargetDeviceModel model;
+    uint64_t max_heap = 1024ULL * 1024 * 1024;
+    uint64_t granularity = 4096;
+    if(device_options.Read(parser, "simulate-apply", model) != 0)
+    {
+        return CLI_EXIT_ERROR;
+    }
+    const std::vector<std::pair<QCommandLineOption*, uint64_t*>> size_options = {
+        {&max_heap_option, &max_heap},
+        {&granularity_option, &granularity},
+    };
+    for(const auto& size_option : size_options)
+    {
+        if(parser.isSet(*size_option.first) && parseByteSize(parser.value(*size_option.first), *size_option.second) != 0)
+        {
+            std::cerr << "simulate-apply: invalid --" << size_option.first->names().first().toStdString() << std::endl;
+            return CLI_EXIT_ERROR;
+        }
+    }
+    max_heap = std::max(max_heap, model.heap_cap);
+
+    BenchPair pair{parser.value(old_option).toStdString(), parser.value(new_option).toStdString()};
+    ConstrainedApplySimulator simulator(model);
+    EvalProbeOptions probes;
+    probes.trace_old_reads = parser.isSet(trace_reads_option);
+    simulator.SetTraceOldReads(probes.trace_old_reads);
+    int exit_code = CLI_EXIT_OK;
+
+    for(const QString& algo : parser.value(algo_option).split(","))
+    {
+        std::string algo_name = algo.trimmed().toStdString();
+        AlgoWrapperFactory factory = AlgoRegistry::Instance().GetFactory(algo_name);
+        auto wrapper = factory ? factory() : nullptr;
+        if(!wrapper || !wrapper->IsConstrainedApplySupported())
+        {
+            std::cerr << algo_name << ": constrained apply not supported" << std::endl;
+            exit_code = CLI_EXIT_ERROR;
+            continue;
+        }
+
+        // Generate the patch on the host first
+        std::string patch_file_path = makeTempPatchPath(algo_name);
+        AlgoEvalResult result;
+        std::string old_md5, new_md5, unused_path;
+        std::chrono::duration<double> duration;
+        uint64_t memory = 0, cpu = 0, patch_size = 0;
+        if(wrapper->SetAlgoEvalFilePath(pair.old_file_path, pair.new_file_path) != 0
+            || wrapper->SetAlgoEvalPatchPath(patch_file_path) != 0
+            || RunEvalInEnv(*wrapper, {}, NoiseThresholds(), result, probes) != 0
+            || result.GetEvalResult(unused_path, unused_path, old_md5, new_md5, duration, memory, cpu) != 0
+            || result.GetEvalPatchSize(patch_size) != 0)
+        {
+            std::cerr << algo_name << ": patch generation failed" << std::endl;
+            removeTempFile(patch_file_path);
+            exit_code = CLI_EXIT_ERROR;
+            continue;
+        }
+
+        ApplySimResult at_cap;
+        MinRamResult min_ram;
+        if(simulator.Run(factory, pair.old_file_path, patch_file_path, new_md5, model.heap_cap, at_cap) != 0
+            || simulator.FindMinimumRam(factory, pair.old_file_path, patch_file_path, new_md5, max_heap, granularity, min_ram) != 0)
+        {
+            std::cerr << algo_name << ": apply simulation failed" << std::endl;
+            removeTempFile(patch_file_path);
+            exit_code = CLI_EXIT_ERROR;
+            continue;
+        }
+        removeTempFile(patch_file_path);
+
+        std::cout << algo_name << std::endl;
+        std::cout << "  patch size:      " << formatBytes(patch_size) << std::endl;
+        if(min_ram.found)
+        {
+            std::cout << "  minimum RAM:     " << formatBytes(min_ram.min_heap)
+                      << " (" << min_ram.attempts << " attempts)" << std::endl;
+        }
+        else
+        {
+            std::cout << "  minimum RAM:     more than " << formatBytes(max_heap) << std::endl;
+        }
+        if(at_cap.output_verified)
+        {
+            std::cout << "  apply @ " << formatBytes(model.heap_cap) << ": ok, peak heap " << formatBytes(at_cap.heap_peak)
+                      << ", projected " << std::fixed << std::setprecision(3) << at_cap.projected_seconds << " s"
+                      << " (host " << at_cap.host_seconds << " s, flash read "
+                      << formatBytes(at_cap.old_read_bytes + at_cap.patch_read_bytes)
+                      << ", written " << formatBytes(at_cap.write_bytes) << ")" << std::endl;
+        }
+        else
+        {
+            std::cout << "  apply @ " << formatBytes(model.heap_cap) << ": "
+                      << (at_cap.success ? "output mismatch" : "does not fit") << std::endl;
+        }
+        AlgoIoAccessSummary diff_access;
+        result.GetEvalOldReadAccess(diff_access);
+        if(diff_access.traced)
+        {
+            printAccessSummary("  generate old reads", diff_access);
+        }
+        if(at_cap.old_read_access.traced)
+        {
+            printAccessSummary("  apply old reads", at_cap.old_read_access);
+        }
+    }
+    return exit_code;
+}
+
+std::string versionLabel(const std::vector<std::string>& version_paths, size_t index)
+{
+    return "v" + std::to_string(index + 1) + " (" + std::filesystem::path(version_paths[index]).filename().string() + ")";
+}
+
+void printChainReport(const DeltaChainReport& report, const std::vector<std::string>& version_paths)
+{
+    std::cout << report.algo_name << ": " << report.edges.size() << " pairs (" << report.generated_edges
+              << " generated, " << report.cached_edges << " cached)" << std::endl;
+    for(const auto& pair : report.edges)
+    {
+        if(pair.first.second - pair.first.first != 1)
+        {
+            continue;
+        }
+        const DeltaEdgeResult& edge = pair.second;
+        std::cout << "  " << versionLabel(version_paths, pair.first.first) << " -> " << versionLabel(version_paths, pair.first.second)
+                  << ": " << formatBytes(edge.patch_size);
+        if(edge.apply_measured && edge.apply_verified)
+        {
+            std::cout << ", apply " << std::fixed << std::setprecision(3) << edge.apply_seconds << " s"
+                      << (edge.apply_hit_cap ? " (hit the heap cap)" : "");
+        }
+        else if(edge.apply_measured)
+        {
+            std::cout << ", apply " << (edge.apply_success ? "output mismatch" : "does not fit");
+        }
+        std::cout << std::endl;
+    }
+    for(const auto& comparison : report.comparisons)
+    {
+        double size_ratio = comparison.chain_patch_size == 0 ? 0.0
+                            : static_cast<double>(comparison.direct.patch_size) / static_cast<double>(comparison.chain_patch_size);
+        std::cout << "  " << versionLabel(version_paths, comparison.from) << " -> " << versionLabel(version_paths, comparison.to)
+                  << ": chain (" << comparison.to - comparison.from << " hops) " << formatBytes(comparison.chain_patch_size)
+                  << ", direct " << formatBytes(comparison.direct.patch_size)
+                  << std::fixed << std::setprecision(1) << " (" << size_ratio * 100.0 << "% of chain)";
+        if(comparison.chain_apply_measured && comparison.direct.apply_measured)
+        {
+            if(comparison.chain_apply_verified && comparison.direct.apply_verified)
+            {
+                std::cout << std::setprecision(3) << ", apply chain " << comparison.chain_apply_seconds
+                          << " s, direct " << comparison.direct.apply_seconds << " s";
+            }
+            else if(!comparison.chain_apply_verified)
+            {
+                std::cout << ", apply unverified (chain " << (comparison.chain_apply_success ? "output mismatch" : "does not fit") << ")";
+            }
+            else
+            {
+                std::cout << ", apply unverified (direct patch " << (comparison.direct.apply_success ? "output mismatch" : "does not fit") << ")";
+            }
+        }
+        std::cout << std::endl;
+    }
+}
+
+int runChainMode(const QStringList& arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Compare chained and direct patches over an ordered sequence of versions.");
+    QCommandLineOption algo_option("algo", "Comma separated algorithm names.", "names");
+    QCommandLineOption versions_option("versions", "Comma separated version files, oldest first.", "files");
+    QCommandLineOption max_skip_option("max-skip", "Largest version distance of a direct patch (default: all).", "n");
+    QCommandLineOption cache_option("cache", "Result cache (JSON), loaded if present and updated.", "file");
+    DeviceModelOptions device_options;
+    parser.addOptions({algo_option, versions_option, max_skip_option, cache_option});
+    device_options.AddTo(parser);
+    int parse_ret = parseModeArguments(parser, arguments, "chain");
+    if(parse_ret != 0)
+    {
+        return parse_ret > 0 ? CLI_EXIT_OK : CLI_EXIT_ERROR;
+    }
+
+    if(!parser.isSet(algo_option) || !parser.isSet(versions_option))
+    {
+        std::cerr << "chain: --algo and --versions are required" << std::endl;
+        return CLI_EXIT_ERROR;
+    }
+    std::vector<std::string> version_paths;
+    for(const QString& version : parser.value(versions_option).split(","))
+    {
+        version_paths.push_back(version.trimmed().toStdString());
+    }
+    if(version_paths.size() < 2)
+    {
+        std::cerr << "chain: at least two versions are required" << std::endl;
+        return CLI_EXIT_ERROR;
+    }
+    size_t max_skip = 0;
+    if(parser.isSet(max_skip_option))
+    {
+        int value = parser.value(max_skip_option).toInt();
+        if(value <= 0)
+        {
+            std::cerr << "chain: invalid --max-skip" << std::endl;
+            return CLI_EXIT_ERROR;
+        }
+        max_skip = static_cast<size_t>(value);
+    }
+    TargetDeviceModel model;
+    if(device_options.Read(parser, "chain", model) != 0)
+    {
+        return CLI_EXIT_ERROR;
+    }
+
+    DeltaResultCache cache;
+    std::string device_tag = DeltaChainEvaluator::MakeDeviceTag(model);
+    std::string cache_path = parser.value(cache_option).toStdString();
+    if(!cache_path.empty() && QFileInfo::exists(parser.value(cache_option)))
+    {
+        if(cache.LoadFromFile(cache_path, device_tag) != 0)
+        {
+            std::cerr << "chain: failed to load cache " << cache_path << std::endl;
+            return CLI_EXIT_ERROR;
+        }
+    }
+
+    DeltaChainEvaluator evaluator(model, cache);
+    int exit_code = CLI_EXIT_OK;
+    for(const QString& algo : parser.value(algo_option).split(","))
+    {
+        std::string algo_name = algo.trimmed().toStdString();
+        AlgoWrapperFactory factory = AlgoRegistry::Instance().GetFactory(algo_name);
+        if(!factory)
+        {
+            std::cerr << algo_name << ": algorithm not registered" << std::endl;
+            exit_code = CLI_EXIT_ERROR;
+            continue;
+        }
+        std::string patch_file_path = makeTempPatchPath(algo_name);
+        DeltaChainReport report;
+        int ret = evaluator.Evaluate(algo_name, factory, version_paths, max_skip, patch_file_path, report);
+        removeTempFile(patch_file_path);
+        if(ret != 0)
+        {
+            std::cerr << algo_name << ": chain evaluation failed" << std::endl;
+            exit_code = CLI_EXIT_ERROR;
+            continue;
+        }
+        printChainReport(report, version_paths);
+    }
+
+    if(!cache_path.empty() && cache.SaveToFile(cache_path, device_tag) != 0)
+    {
+        std::cerr << "chain: failed to write cache " << cache_path << std::endl;
+        return CLI_EXIT_ERROR;
+    }
+    return exit_code;
+}
+
+void printLoadTestResults(const std::string& algo_name, const LoadTestConfig& config, const std::vector<LoadTestResult>& results)
+{
+    std::cout << algo_name << " (" << (config.mode == LoadTestMode::FixedRate ? "fixed rate" : "closed loop");
+    if(config.mode == LoadTestMode::FixedRate)
+    {
+        std::cout << " " << config.arrival_rate << " jobs/s";
+    }
+    std::cout << ", " << config.duration_seconds << " s per level)" << std::endl;
+    std::cout << "  " << std::setw(5) << "conc" << std::setw(8) << "jobs" << std::setw(6) << "fail" << std::setw(6) << "drop"
+              << std::setw(10) << "jobs/s" << std::setw(9) << "mean" << std::setw(9) << "p50" << std::setw(9) << "p90"
+              << std::setw(9) << "p99" << std::setw(9) << "max" << std::setw(13) << "peak RSS" << std::endl;
+    for(const auto& result : results)
+    {
+        std::cout << "  " << std::setw(5) << result.concurrency << std::setw(8) << result.completed
+                  << std::setw(6) << result.failed << std::setw(6) << result.dropped
+                  << std::fixed << std::setprecision(2) << std::setw(10) << result.throughput
+                  << std::setprecision(3) << std::setw(9) << result.latency_mean << std::setw(9) << result.latency_p50
+                  << std::setw(9) << result.latency_p90 << std::setw(9) << result.latency_p99 << std::setw(9) << result.latency_max
+                  << std::setw(13) << formatBytes(result.rss_peak) << std::endl;
+        if(result.unpinned_workers > 0)
+        {
+            std::cerr << "warning: " << algo_name << ": " << result.unpinned_workers << " worker(s) ran unpinned at concurrency "
+                      << result.concurrency << ", not enough free CPUs" << std::endl;
+        }
+    }
+
+    if(config.mode == LoadTestMode::FixedRate)
+    {
+        // Throughput is capped by the arrival rate, so saturation shows as dropped jobs or queueing in the tail
+        for(size_t level = 0; level < results.size(); level++)
+        {
+            if(results[level].dropped > 0 || (level > 0 && results[level].latency_p99 > results[0].latency_p99 * 2.0))
+            {
+                std::cout << "  falls behind the arrival rate at concurrency " << results[level].concurrency
+                          << (results[level].dropped > 0 ? " (jobs dropped)" : " (p99 more than doubled)") << std::endl;
+                return;
+            }
+        }
+        std::cout << "  keeps up with the arrival rate at every level" << std::endl;
+        return;
+    }
+
+    // Saturation: first level where adding jobs in flight gains less than 10% throughput
+    for(size_t level = 1; level < results.size(); level++)
+    {
+        if(results[level].throughput < results[level - 1].throughput * 1.10)
+        {
+            std::cout << "  saturates at concurrency " << results[level - 1].concurrency << std::endl;
+            break;
+        }
+    }
+}
+
+int runLoadTestMode(const QStringList& arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Drive patch generation with concurrent jobs and report throughput and tail latency.");
+    QCommandLineOption bench_set_option("bench-set", "Bench set providing the input pairs (JSON).", "file");
+    QCommandLineOption algo_option("algo", "Comma separated algorithm names (overrides the bench set).", "names");
+    QCommandLineOption concurrency_option("concurrency", "Comma separated concurrency levels to sweep (default 1).", "levels");
+    QCommandLineOption rate_option("rate", "Fixed arrival rate in jobs per second, closed loop when not set.", "jobs");
+    QCommandLineOption duration_option("duration", "Seconds jobs are issued per level (default 10).", "seconds");
+    QCommandLineOption jobs_option("jobs", "Stop issuing after this many jobs per level.", "n");
+    QCommandLineOption cpus_option("cpus", "CPUs workers may be pinned to, e.g. 2-7.", "list");
+    QCommandLineOption cpus_per_job_option("cpus-per-job", "Pin each worker to this many CPUs.", "n");
+    parser.addOptions({bench_set_option, algo_option, concurrency_option, rate_option, duration_option, jobs_option,
+                       cpus_option, cpus_per_job_option});
+    int parse_ret = parseModeArguments(parser, arguments, "load-test");
+    if(parse_ret != 0)
+    {
+        return parse_ret > 0 ? CLI_EXIT_OK : CLI_EXIT_ERROR;
+    }
+
+    BenchSet bench_set;
+    if(!parser.isSet(bench_set_option) || loadBenchSet(parser.value(bench_set_option), bench_set) != 0)
+    {
+        std::cerr << "load-test: --bench-set is required and must be valid" << std::endl;
+        return CLI_EXIT_ERROR;
+    }
+    if(parser.isSet(algo_option))
+    {
+        bench_set.algo_names.clear();
+        for(const QString& algo : parser.value(algo_option).split(","))
+        {
+            bench_set.algo_names.push_back(algo.trimmed().toStdString());
+        }
+    }
+
+    std::vector<int> concurrency_levels = {1};
+    if(parser.isSet(concurrency_option))
+    {
+        concurrency_levels.clear();
+        for(const QString& level : parser.value(concurrency_option).split(","))
+        {
+            int concurrency = level.trimmed().toInt();
+            if(concurrency <= 0)
+            {
+                std::cerr << "load-test: invalid --concurrency" << std::endl;
+                return CLI_EXIT_ERROR;
+            }
+            concurrency_levels.push_back(concurrency);
+        }
+    }
+
+    LoadTestConfig config;
+    bool ok = true;
+    if(parser.isSet(rate_option))
+    {
+        config.mode = LoadTestMode::FixedRate;
+        config.arrival_rate = parser.value(rate_option).toDouble(&ok);
+        if(!ok || config.arrival_rate <= 0.0)
+        {
+            std::cerr << "load-test: invalid --rate" << std::endl;
+            return CLI_EXIT_ERROR;
+        }
+    }
+    if(parser.isSet(duration_option))
+    {
+        config.duration_seconds = parser.value(duration_option).toDouble(&ok);
+        if(!ok || config.duration_seconds <= 0.0)
+        {
+            std::cerr << "load-test: invalid --duration" << std::endl;
+            return CLI_EXIT_ERROR;
+        }
+    }
+    if(parser.isSet(jobs_option))
+    {
+        int jobs = parser.value(jobs_option).toInt();
+        if(jobs <= 0)
+        {
+            std::cerr << "load-test: invalid --jobs" << std::endl;
+            return CLI_EXIT_ERROR;
+        }
+        config.max_jobs = static_cast<uint64_t>(jobs);
+    }
+
+    ExecEnvController env_controller;
+    if(parser.isSet(cpus_option) && env_controller.SetCpuSet(ExecEnvController::ParseCpuList(parser.value(cpus_option).toStdString())) != 0)
+    {
+        std::cerr << "load-test: invalid --cpus" << std::endl;
+        return CLI_EXIT_ERROR;
+    }
+    if(parser.isSet(cpus_per_job_option))
+    {
+        int cpus_per_job = parser.value(cpus_per_job_option).toInt();
+        if(cpus_per_job <= 0)
+        {
+            std::cerr << "load-test: invalid --cpus-per-job" << std::endl;
+            return CLI_EXIT_ERROR;
+        }
+        config.cpus_per_job = static_cast<size_t>(cpus_per_job);
+    }
+
+    std::vector<LoadTestPair> pairs;
+    for(const auto& pair : bench_set.pairs)
+    {
+        pairs.push_back(LoadTestPair{pair.old_file_path, pair.new_file_path});
+    }
+
+    int exit_code = CLI_EXIT_OK;
+    for(const auto& algo_name : bench_set.algo_names)
+    {
+        AlgoWrapperFactory factory = AlgoRegistry::Instance().GetFactory(algo_name);
+        if(!factory)
+        {
+            std::cerr << algo_name << ": algorithm not registered" << std::endl;
+            exit_code = CLI_EXIT_ERROR;
+            continue;
+        }
+        LoadTester tester(factory, pairs, &env_controller);
+        std::vector<LoadTestResult> results;
+        if(tester.Sweep(config, concurrency_levels, results) != 0)
+        {
+            std::cerr << algo_name << ": load test failed" << std::endl;
+            exit_code = CLI_EXIT_ERROR;
+            continue;
+        }
+        printLoadTestResults(algo_name, config, results);
+    }
+    return exit_code;
+}
+
+void printRaceResult(const RaceResult& result)
+{
+    for(const auto& entry : result.entries)
+    {
+        std::cout << std::left << std::setw(16) << entry.algo_name << std::setw(10) << AlgoRacer::GetOutcomeName(entry.outcome)
+                  << std::right << std::fixed << std::setprecision(3) << std::setw(9) << entry.seconds << " s";
+        if(entry.outcome == RaceOutcome::Won || entry.outcome == RaceOutcome::Finished)
+        {
+            std::cout << "  patch " << formatBytes(entry.patch_size) << ", memory " << formatBytes(entry.memory);
+        }
+        else if(entry.outcome == RaceOutcome::Cut)
+        {
+            std::cout << "  " << entry.reason << (entry.cancel_honoured ? "" : " (ran to completion)");
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "winner: " << (result.winner.empty() ? "none" : result.winner) << " after "
+              << std::setprecision(3) << result.wall_seconds << " s" << std::endl;
+}
+
+int runRaceMode(const QStringList& arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Start several algorithms on one pair together and cut the ones that can no longer win.");
+    QCommandLineOption algo_option("algo", "Comma separated algorithm names.", "names");
+    QCommandLineOption old_option("old", "Old file.", "file");
+    QCommandLineOption new_option("new", "New file.", "file");
+    QCommandLineOption time_factor_option("time-factor", "Cut after this multiple of the fastest finish, 0 to disable (default 2).", "x");
+    QCommandLineOption memory_factor_option("memory-factor", "Cut above this multiple of the smallest finished memory, 0 to disable (default 4).", "x");
+    QCommandLineOption no_size_cut_option("no-size-cut", "Do not cut when the partial output passes the smallest finished patch.");
+    parser.addOptions({algo_option, old_option, new_option, time_factor_option, memory_factor_option, no_size_cut_option});
+    int parse_ret = parseModeArguments(parser, arguments, "race");
+    if(parse_ret != 0)
+    {
+        return parse_ret > 0 ? CLI_EXIT_OK : CLI_EXIT_ERROR;
+    }
+
+    if(!parser.isSet(algo_option) || !parser.isSet(old_option) || !parser.isSet(new_option))
+    {
+        std::cerr << "race: --algo, --old and --new are required" << std::endl;
+        return CLI_EXIT_ERROR;
+    }
+
+    RaceConfig config;
+    config.cut_on_patch_size = !parser.isSet(no_size_cut_option);
+    const std::vector<std::pair<QCommandLineOption*, double*>> factor_options = {
+        {&time_factor_option, &config.time_factor},
+        {&memory_factor_option, &config.memory_factor},
+    };
+    for(const auto& factor_option : factor_options)
+    {
+        if(parser.isSet(*factor_option.first))
+        {
+            bool ok = false;
+            *factor_option.second = parser.value(*factor_option.first).toDouble(&ok);
+            if(!ok || *factor_option.second < 0.0 || (*factor_option.second > 0.0 && *factor_option.second < 1.0))
+            {
+                std::cerr << "race: invalid --" << factor_option.first->names().first().toStdString() << std::endl;
+                return CLI_EXIT_ERROR;
+            }
+        }
+    }
+
+    std::vector<std::pair<std::string, AlgoWrapperFactory>> contestants;
+    for(const QString& algo : parser.value(algo_option).split(","))
+    {
+        std::string algo_name = algo.trimmed().toStdString();
+        AlgoWrapperFactory factory = AlgoRegistry::Instance().GetFactory(algo_name);
+        if(!factory)
+        {
+            std::cerr << "race: algorithm not registered: " << algo_name << std::endl;
+            return CLI_EXIT_ERROR;
+        }
+        contestants.emplace_back(algo_name, factory);
+    }
+
+    AlgoRacer racer(contestants);
+    RaceResult result;
+    if(racer.Run(parser.value(old_option).toStdString(), parser.value(new_option).toStdString(), config, result) != 0)
+    {
+        std::cerr << "race: failed to start the race" << std::endl;
+        return CLI_EXIT_ERROR;
+    }
+    printRaceResult(result);
+    return result.winner.empty() ? CLI_EXIT_ERROR : CLI_EXIT_OK;
+}
+
+const std::map<std::string, std::function<int(const QStringList&)>>& cliModes()
+{
+    static const std::map<std::string, std::function<int(const QStringList&)>> modes = {
+        {"compare", runCompareMode},
+        {"simulate-apply", runSimulateApplyMode},
+        {"chain", runChainMode},
+        {"load-test", runLoadTestMode},
+        {"race", runRaceMode},
+    };
+    return modes;
+}
+
+} // namespace
+
+bool IsEvalCliInvocation(int argc, char *argv[])
+{
+    if(argc < 2)
+    {
+        return false;
+    }
+    return cliModes().count(argv[1]) != 0;
+}
+
+int RunEvalCli(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationVersion(QStringLiteral(DAE_VERSION));
+
+    // Drop the mode name so that each mode parses its own options
+    QStringList arguments = app.arguments();
+    std::string mode = arguments.at(1).toStdString();
+    arguments.removeAt(1);
+    return cliModes().at(mode)(arguments);
+}
@@ -0,0 +1,17 @@
+#ifndef EVAL_CLI_H
+#define EVAL_CLI_H
+
+/*
+    Headless evaluation modes, selected by the first command line argument:
+
+    DiffAlgoEval compare --bench-set <set.json> --baseline <baseline.json> [options]
+    DiffAlgoEval simulate-apply --algo <names> --old <file> --new <file> [options]
+    DiffAlgoEval chain --algo <names> --versions <v1,v2,...> [options]
+    DiffAlgoEval load-test --bench-set <set.json> --concurrency <1,2,4,...> [options]
+    DiffAlgoEval race --algo <names> --old <file> --new <file> [options]
+*/
+
+bool IsEvalCliInvocation(int argc, char *argv[]);
+int RunEvalCli(int argc, char *argv[]);
+
+#endif // EVAL_CLI_H
@@ -0,0 +1,496 @@
+#include "eval_result_view.h"
+
+#include <QPainter>
+#include <QPaintEvent>
+#include <QFontMetrics>
+#include <QColor>
+
+#include <algorithm>
+#include <utility>
+#include <chrono>
+
+#include "eval_baseline.h"
+
+int MakeEvalResultRecord(const std::string& algo_name, AlgoEvalResult& result, EvalResultRecord& record)
+{
+    std::chrono::duration<double> duration;
+    record = EvalResultRecord();
+    record.algo_name = algo_name;
+    if(result.GetEvalResult(record.old_file_path, record.new_file_path, record.old_file_md5, record.new_file_md5,
+                            duration, record.memory, record.cpu) != 0)
+    {
+        return -1; // Evaluation not finished
+    }
+    if(result.GetEvalPatchSize(record.patch_size) != 0)
+    {
+        return -1; // Evaluation not finished
+    }
+    record.duration = duration.count();
+    record.io_mode = AlgoEvalResult::GetEvalIoModeName(result.GetEvalIoMode());
+    AlgoEvalEnv env;
+    result.GetEvalEnv(env);
+    record.env_warnings = env.warnings;
+    AlgoOldIndexState index_state = AlgoOldIndexState::None;
+    std::chrono::duration<double> build_duration, incremental_duration;
+    if(result.GetEvalOldIndex(index_state, build_duration, incremental_duration) != 0)
+    {
+        return -1; // Evaluation not finished
+    }
+    record.old_index = AlgoEvalResult::GetOldIndexStateName(index_state);
+    record.old_index_build_duration = build_duration.count();
+    return 0; // Success
+}
+
+int LoadEvalResultRecords(const std::string& file_path, std::vector<EvalResultRecord>& records)
+{
+    EvalBaseline baseline;
+    if(baseline.LoadFromFile(file_path) != 0)
+    {
+        return -1; // Failed to load the file
+    }
+    records.clear();
+    for(const auto& pair : baseline.GetCases())
+    {
+        const EvalCase& eval_case = pair.second;
+        for(const auto& sample : eval_case.samples)
+        {
+            EvalResultRecord record;
+            record.algo_name = eval_case.preprocess.empty() ? eval_case.algo_name : eval_case.algo_name + " [" + eval_case.preprocess + "]";
+            record.io_mode = eval_case.io_mode;
+            record.old_file_path = eval_case.old_file_path;
+            record.new_file_path = eval_case.new_file_path;
+            record.old_file_md5 = eval_case.old_file_md5;
+            record.new_file_md5 = eval_case.new_file_md5;
+            record.duration = sample.duration;
+            record.memory = sample.memory;
+            record.cpu = sample.cpu;
+            record.patch_size = sample.patch_size;
+            record.old_index = sample.old_index;
+            record.old_index_build_duration = sample.old_index_build_duration;
+            records.push_back(record);
+        }
+    }
+    return 0; // Success
+}
+
+EvalResultModel::EvalResultModel(QObject *parent) : QAbstractTableModel(parent)
+{
+}
+
+int EvalResultModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : exposed_rows;
+}
+
+int EvalResultModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant EvalResultModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid() || index.row() >= exposed_rows)
+    {
+        return QVariant();
+    }
+    const EvalResultRecord& record = GetRecord(index.row());
+    if(role == SortRole)
+    {
+        switch(index.column())
+        {
+        case ColumnAlgo:
+            return QString::fromStdString(record.algo_name);
+        case ColumnIoMode:
+            return QString::fromStdString(record.io_mode);
+        case ColumnOldMd5:
+            return QString::fromStdString(record.old_file_md5);
+        case ColumnNewMd5:
+            return QString::fromStdString(record.new_file_md5);
+        default:
+            return GetMetricValue(record, index.column());
+        }
+    }
+    if(role == Qt::DisplayRole)
+    {
+        switch(index.column())
+        {
+        case ColumnAlgo:
+            return QString::fromStdString(record.algo_name);
+        case ColumnIoMode:
+            return QString::fromStdString(record.io_mode);
+        case ColumnOldMd5:
+            return QString::fromStdString(record.old_file_md5);
+        case ColumnNewMd5:
+            return QString::fromStdString(record.new_file_md5);
+        case ColumnDuration:
+            return QString::number(record.duration, 'f', 3);
+        case ColumnMemory:
+            return QString::number(record.memory);
+        case ColumnCpu:
+            return QString::number(record.cpu);
+        case ColumnPatchSize:
+            return QString::number(record.patch_size);
+        default:
+            return QVariant();
+        }
+    }
+    if(role == Qt::ToolTipRole && index.column() == ColumnAlgo && !record.env_warnings.empty())
+    {
+        QStringList warnings;
+        for(const auto& warning : record.env_warnings)
+        {
+            warnings.append(QString::fromStdString(warning));
+        }
+        return warnings.join("\n");
+    }
+    if(role == Qt::ToolTipRole && index.column() == ColumnDuration && record.old_index != "none")
+    {
+        return QString("Old index %1, build %2 s, incremental %3 s")
+            .arg(QString::fromStdString(record.old_index))
+            .arg(record.old_index_build_duration, 0, 'f', 3)
+            .arg(record.duration - record.old_index_build_duration, 0, 'f', 3);
+    }
+    if(role == Qt::ToolTipRole && (index.column() == ColumnOldMd5 || index.column() == ColumnNewMd5))
+    {
+        return QString::fromStdString(index.column() == ColumnOldMd5 ? record.old_file_path : record.new_file_path);
+    }
+    return QVariant();
+}
+
+QVariant EvalResultModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if(role != Qt::DisplayRole || orientation != Qt::Horizontal)
+    {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch(section)
+    {
+    case ColumnAlgo:
+        return QString("Algorithm");
+    case ColumnIoMode:
+        return QString("I/O");
+    case ColumnOldMd5:
+        return QString("Old MD5");
+    case ColumnNewMd5:
+        return QString("New MD5");
+    case ColumnDuration:
+        return QString("Duration (s)");
+    case ColumnMemory:
+        return QString("Memory (B)");
+    case ColumnCpu:
+        return QString("CPU (%)");
+    case ColumnPatchSize:
+        return QString("Patch (B)");
+    default:
+        return QVariant();
+    }
+}
+
+bool EvalResultModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && static_cast<size_t>(exposed_rows) < view_rows.size();
+}
+
+void EvalResultModel::fetchMore(const QModelIndex &parent)
+{
+    if(parent.isValid())
+    {
+        return;
+    }
+    int remaining = static_cast<int>(view_rows.size()) - exposed_rows;
+    int count = std::min(remaining, static_cast<int>(FetchBatchSize));
+    if(count <= 0)
+    {
+        return;
+    }
+    beginInsertRows(QModelIndex(), exposed_rows, exposed_rows + count - 1);
+    exposed_rows += count;
+    endInsertRows();
+}
+
+void EvalResultModel::sort(int column, Qt::SortOrder order)
+{
+    sort_column = (column >= 0 && column < ColumnCount) ? column : -1;
+    sort_order = order;
+    rebuildView(exposed_rows); // Keep what the view has already scrolled through
+}
+
+void EvalResultModel::AppendResult(const EvalResultRecord& record)
+{
+    // A single row goes to its sorted place. It is shown right away when it lands
+    // among the exposed rows or right after a fully exposed table, otherwise it
+    // waits for the view to fetch it.
+    bool fully_exposed = static_cast<size_t>(exposed_rows) == view_rows.size();
+    records.push_back(record);
+    addAlgoName(record.algo_name);
+    size_t index = records.size() - 1;
+    if(acceptsRecord(record))
+    {
+        addToSummary(record);
+        auto it = view_rows.end();
+        if(sort_column >= 0)
+        {
+            it = std::upper_bound(view_rows.begin(), view_rows.end(), index,
+                                  [this](size_t left, size_t right) { return lessThan(left, right); });
+        }
+        int row = static_cast<int>(it - view_rows.begin());
+        if(row < exposed_rows || (row == exposed_rows && fully_exposed))
+        {
+            beginInsertRows(QModelIndex(), row, row);
+            view_rows.insert(it, index);
+            exposed_rows++;
+            endInsertRows();
+        }
+        else
+        {
+            view_rows.insert(it, index);
+        }
+    }
+    emit summaryChanged();
+}
+
+void EvalResultModel::AppendResults(const std::vector<EvalResultRecord>& new_records)
+{
+    if(new_records.empty())
+    {
+        return;
+    }
+    if(new_records.size() == 1)
+    {
+        AppendResult(new_records.front());
+        return;
+    }
+    // Inserting a large batch row by row would shift the order once per row, sort once instead
+    records.reserve(records.size() + new_records.size());
+    for(const auto& record : new_records)
+    {
+        records.push_back(record);
+        addAlgoName(record.algo_name);
+    }
+    rebuildView(exposed_rows);
+    emit summaryChanged();
+}
+
+void EvalResultModel::Clear()
+{
+    beginResetModel();
+    records.clear();
+    view_rows.clear();
+    exposed_rows = 0;
+    algo_names.clear();
+    summaries.clear();
+    endResetModel();
+    emit summaryChanged();
+}
+
+void EvalResultModel::SetFilter(const Filter& new_filter)
+{
+    filter = new_filter;
+    rebuildView(0);
+    emit summaryChanged();
+}
+
+QStringList EvalResultModel::GetAlgoNames() const
+{
+    QStringList names;
+    for(const auto& algo_name : algo_names)
+    {
+        names.append(QString::fromStdString(algo_name));
+    }
+    return names;
+}
+
+int EvalResultModel::GetSummary(const std::string& algo_name, int column, MetricSummary& summary) const
+{
+    auto it = summaries.find(algo_name);
+    if(it == summaries.end() || column < ColumnDuration || column >= ColumnCount)
+    {
+        return -1; // Unknown algorithm or not a metric column
+    }
+    summary = it->second[static_cast<size_t>(column - ColumnDuration)];
+    return 0; // Success
+}
+
+double EvalResultModel::GetMetricValue(const EvalResultRecord& record, int column)
+{
+    switch(column)
+    {
+    case ColumnDuration:
+        return record.duration;
+    case ColumnMemory:
+        return static_cast<double>(record.memory);
+    case ColumnCpu:
+        return static_cast<double>(record.cpu);
+    case ColumnPatchSize:
+        return static_cast<double>(record.patch_size);
+    default:
+        return 0.0;
+    }
+}
+
+void EvalResultModel::addAlgoName(const std::string& algo_name)
+{
+    if(algo_names.insert(algo_name).second)
+    {
+        emit algoAdded(QString::fromStdString(algo_name));
+    }
+}
+
+void EvalResultModel::addToSummary(const EvalResultRecord& record)
+{
+    auto& metrics = summaries[record.algo_name];
+    for(int column = ColumnDuration; column < ColumnCount; ++column)
+    {
+        MetricSummary& summary = metrics[static_cast<size_t>(column - ColumnDuration)];
+        double value = GetMetricValue(record, column);
+        summary.min = (summary.count == 0) ? value : std::min(summary.min, value);
+        summary.max = (summary.count == 0) ? value : std::max(summary.max, value);
+        summary.sum += value;
+        summary.count++;
+    }
+}
+
+bool EvalResultModel::acceptsRecord(const EvalResultRecord& record) const
+{
+    if(!filter.algo_name.empty() && record.algo_name != filter.algo_name)
+    {
+        return false;
+    }
+    if(!filter.hash_part.empty()
+        && record.old_file_md5.find(filter.hash_part) == std::string::npos
+        && record.new_file_md5.find(filter.hash_part) == std::string::npos)
+    {
+        return false;
+    }
+    double value = GetMetricValue(record, filter.metric_column);
+    if((filter.has_min && value < filter.min) || (filter.has_max && value > filter.max))
+    {
+        return false;
+    }
+    return true;
+}
+
+bool EvalResultModel::lessThan(size_t left, size_t right) const
+{
+    if(sort_order == Qt::DescendingOrder)
+    {
+        std::swap(left, right);
+    }
+    const EvalResultRecord& left_record = records[left];
+    const EvalResultRecord& right_record = records[right];
+    switch(sort_column)
+    {
+    case ColumnAlgo:
+        return left_record.algo_name < right_record.algo_name;
+    case ColumnIoMode:
+        return left_record.io_mode < right_record.io_mode;
+    case ColumnOldMd5:
+        return left_record.old_file_md5 < right_record.old_file_md5;
+    case ColumnNewMd5:
+        return left_record.new_file_md5 < right_record.new_file_md5;
+    default:
+        return GetMetricValue(left_record, sort_column) < GetMetricValue(right_record, sort_column);
+    }
+}
+
+void EvalResultModel::rebuildView(int min_exposed)
+{
+    beginResetModel();
+    view_rows.clear();
+    summaries.clear();
+    for(size_t index = 0; index < records.size(); ++index)
+    {
+        if(acceptsRecord(records[index]))
+        {
+            view_rows.push_back(index);
+            addToSummary(records[index]);
+        }
+    }
+    if(sort_column >= 0)
+    {
+        // Stable, so equal rows keep their arrival order
+        std::stable_sort(view_rows.begin(), view_rows.end(), [this](size_t left, size_t right) { return lessThan(left, right); });
+    }
+    exposed_rows = static_cast<int>(std::min(view_rows.size(), static_cast<size_t>(std::max(min_exposed, static_cast<int>(FetchBatchSize)))));
+    endResetModel();
+}
+
+EvalResultChart::EvalResultChart(QWidget *parent) : QWidget(parent)
+{
+    repaint_timer.setSingleShot(true);
+    repaint_timer.setInterval(200);
+    connect(&repaint_timer, &QTimer::timeout, this, QOverload<>::of(&QWidget::update));
+}
+
+void EvalResultChart::SetModel(EvalResultModel* model)
+{
+    result_model = model;
+    connect(result_model, &EvalResultModel::summaryChanged, this, [this]() {
+        if(!repaint_timer.isActive())
+        {
+            repaint_timer.start();
+        }
+    });
+    update();
+}
+
+void EvalResultChart::SetMetric(int column)
+{
+    metric_column = column;
+    update();
+}
+
+void EvalResultChart::paintEvent(QPaintEvent *event)
+{
+    (void)event;
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::white);
+    if(result_model == nullptr)
+    {
+        return;
+    }
+
+    QStringList algo_names = result_model->GetAlgoNames();
+    std::vector<double> means;
+    double max_mean = 0.0;
+    for(const QString& algo_name : algo_names)
+    {
+        EvalResultModel::MetricSummary summary;
+        double mean = 0.0;
+        if(result_model->GetSummary(algo_name.toStdString(), metric_column, summary) == 0 && summary.count > 0)
+        {
+            mean = summary.sum / static_cast<double>(summary.count);
+        }
+        means.push_back(mean);
+        max_mean = std::max(max_mean, mean);
+    }
+
+    QString title = result_model->headerData(metric_column, Qt::Horizontal).toString() + " (mean)";
+    painter.setPen(Qt::black);
+    painter.drawText(QRect(0, 0, width(), 20), Qt::AlignCenter, title);
+    if(algo_names.isEmpty() || max_mean <= 0.0)
+    {
+        return;
+    }
+
+    // One horizontal bar per algorithm
+    const int top = 24;
+    const int row_height = std::max(18, std::min(40, (height() - top) / static_cast<int>(algo_names.size())));
+    const int label_width = 60;
+    const int bar_space = std::max(1, width() - label_width - 4);
+    for(int i = 0; i < algo_names.size(); ++i)
+    {
+        int y = top + i * row_height;
+        if(y + row_height > height())
+        {
+            break; // No room for more bars
+        }
+        int bar_width = static_cast<int>(bar_space * (means[static_cast<size_t>(i)] / max_mean));
+        painter.setPen(Qt::black);
+        painter.drawText(QRect(2, y, label_width - 4, row_height), Qt::AlignVCenter | Qt::AlignLeft,
+                         painter.fontMetrics().elidedText(algo_names.at(i), Qt::ElideRight, label_width - 4));
+        painter.fillRect(QRect(label_width, y + 3, bar_width, row_height - 6), QColor(70, 130, 180));
+        painter.drawText(QRect(label_width + 2, y, bar_space, row_height), Qt::AlignVCenter | Qt::AlignLeft,
+                         QString::number(means[static_cast<size_t>(i)], 'g', 4));
+    }
+}
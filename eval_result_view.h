@@ -0,0 +1,152 @@
+#ifndef EVAL_RESULT_VIEW_H
+#define EVAL_RESULT_VIEW_H
+
+#include <QAbstractTableModel>
+#include <QWidget>
+#include <QTimer>
+#include <QString>
+#include <QStringList>
+
+#include <map>
+#include <set>
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "base_algo_wrapper.h"
+
+struct EvalResultRecord
+{
+    std::string algo_name;
+    std::string io_mode;
+    std::string old_file_path;
+    std::string new_file_path;
+    std::string old_file_md5;
+    std::string new_file_md5;
+    double duration = 0.0; // Seconds
+    uint64_t memory = 0; // Bytes
+    uint64_t cpu = 0; // Percentage
+    uint64_t patch_size = 0; // Bytes
+    std::vector<std::string> env_warnings; // Noisy measurement conditions, see AlgoEvalEnv
+    std::string old_index = "none"; // Whether the old file index was built or reused
+    double old_index_build_duration = 0.0; // Seconds, part of duration
+};
+
+int MakeEvalResultRecord(const std::string& algo_name, AlgoEvalResult& result, EvalResultRecord& record);
+int LoadEvalResultRecords(const std::string& file_path, std::vector<EvalResultRecord>& records); // Baseline JSON files
+
+// Table model over all results. Filtering and sorting run over every record
+// and produce the row order; only then are rows exposed to views in batches
+// through canFetchMore()/fetchMore(), so loading a large result set does not
+// make the view lay out every row up front, and the first rows really are the
+// top of the whole set. Filtering here rather than in a proxy matters because a
+// proxy only sees the rows exposed so far. Per algorithm summaries cover the
+// records passing the filter, so the chart shows what the table shows; they are
+// kept up to date on append and rebuilt with the view when the filter changes.
+class EvalResultModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column
+    {
+        ColumnAlgo = 0,
+        ColumnIoMode,
+        ColumnOldMd5,
+        ColumnNewMd5,
+        ColumnDuration,
+        ColumnMemory,
+        ColumnCpu,
+        ColumnPatchSize,
+        ColumnCount
+    };
+    static constexpr int SortRole = Qt::UserRole; // Raw values of the cells
+    static constexpr int FetchBatchSize = 256;
+    static constexpr int MetricCount = ColumnCount - ColumnDuration;
+
+    struct MetricSummary
+    {
+        double sum = 0.0;
+        double min = 0.0;
+        double max = 0.0;
+        uint64_t count = 0;
+    };
+
+    // Empty strings and unset bounds match all
+    struct Filter
+    {
+        std::string algo_name;
+        std::string hash_part; // Substring of either MD5, lower case
+        int metric_column = ColumnDuration;
+        bool has_min = false;
+        bool has_max = false;
+        double min = 0.0;
+        double max = 0.0;
+    };
+
+    explicit EvalResultModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+    void AppendResult(const EvalResultRecord& record);
+    void AppendResults(const std::vector<EvalResultRecord>& new_records);
+    void Clear();
+    void SetFilter(const Filter& new_filter);
+
+    const EvalResultRecord& GetRecord(int row) const { return records[view_rows[static_cast<size_t>(row)]]; } // Row as shown
+    size_t GetTotalCount() const { return records.size(); }
+    size_t GetMatchCount() const { return view_rows.size(); } // Records passing the filter, exposed or not
+    QStringList GetAlgoNames() const;
+    int GetSummary(const std::string& algo_name, int column, MetricSummary& summary) const;
+    static double GetMetricValue(const EvalResultRecord& record, int column);
+
+signals:
+    void algoAdded(const QString& algo_name);
+    void summaryChanged();
+
+private:
+    void addAlgoName(const std::string& algo_name);
+    void addToSummary(const EvalResultRecord& record);
+    bool acceptsRecord(const EvalResultRecord& record) const;
+    bool lessThan(size_t left, size_t right) const; // Record indexes, in the current sort order
+    void rebuildView(int min_exposed); // Refilters and resorts all records, then exposes at least min_exposed rows
+
+    std::vector<EvalResultRecord> records; // In arrival order
+    std::vector<size_t> view_rows; // Indexes of the records passing the filter, sorted
+    int exposed_rows = 0; // Leading view rows visible to views, the rest wait for fetchMore()
+    Filter filter;
+    int sort_column = -1; // -1 keeps the arrival order
+    Qt::SortOrder sort_order = Qt::AscendingOrder;
+    std::set<std::string> algo_names; // Every algorithm seen, filtered or not
+    std::map<std::string, std::array<MetricSummary, MetricCount>> summaries; // Records passing the filter only
+};
+
+// Bar chart of the per algorithm mean of one metric. Repaints are coalesced so
+// a burst of appended results costs one repaint.
+class EvalResultChart : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit EvalResultChart(QWidget *parent = nullptr);
+
+    void SetModel(EvalResultModel* model);
+    void SetMetric(int column);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    EvalResultModel* result_model = nullptr;
+    int metric_column = EvalResultModel::ColumnDuration;
+    QTimer repaint_timer;
+};
+
+#endif // EVAL_RESULT_VIEW_H
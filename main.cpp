@@ -3,6 +3,9 @@
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QThread>
+#include <QHeaderView>
+#include <QVBoxLayout>
 
 #include <map>
 #include <vector>
@@ -12,8 +15,14 @@
 #include <filesystem>
 #include <stdexcept>
 #include <cstdint>
+#include <memory>
+#include <algorithm>
 #include "DiffAlgoEval.h"
 #include "mock_algo.h"
+#include "algo_registry.h"
+#include "eval_cli.h"
+#include "eval_result_view.h"
+#include "exec_env.h"
 class AlgoSelect 
 {
 public:
@@ -245,6 +254,17 @@ public:
         connect(ui.pushButton_filecfm, &QPushButton::clicked, this, &MainWindow::onPushButtonFileConfirmClicked);
         connect(ui.pushButton_fileresel, &QPushButton::clicked, this, &MainWindow::onPushButtonFileReselectClicked);
         connect(ui.pushButton_starteval, &QPushButton::clicked, this, &MainWindow::onPushButtonStartEvalClicked);
+        connect(ui.pushButton_loadresults, &QPushButton::clicked, this, &MainWindow::onPushButtonLoadResultsClicked);
+        connect(ui.pushButton_clearresults, &QPushButton::clicked, this, &MainWindow::onPushButtonClearResultsClicked);
+        setupResultView();
+    }
+
+    ~MainWindow() override
+    {
+        for(QThread* eval_thread : eval_threads)
+        {
+            eval_thread->wait(); // Evaluations cannot be interrupted, let them finish
+        }
     }
 
 private slots:
@@ -381,49 +401,135 @@ private slots:
         
         // Start the evaluation process here
         std::string old_file_path, new_file_path;
-        std::string old_file_md5;
-        std::string new_file_md5;
-        std::chrono::duration<double> duration;
-        uint64_t memory;
-        uint64_t cpu;
-        MockAlgo mockAlgo;
-        AlgoEvalResult result;
-
         if(file_sel.GetFileSelect(old_file_path, new_file_path) != 0)
         {
             QMessageBox::warning(this, "Warning", "Failed to get file selection.");
             return;
         }
-        mockAlgo.SetAlgoEvalFilePath(old_file_path, new_file_path);
-        mockAlgo.StartEval();
-        if(mockAlgo.GetEvalResult(result) != 0)
+
+        // Evaluate in a worker thread and append the result to the table when it finishes
+        QThread* eval_thread = QThread::create([this, old_file_path, new_file_path]() {
+            MockAlgo mockAlgo;
+            AlgoEvalResult result;
+            EvalResultRecord record;
+            bool ok = mockAlgo.SetAlgoEvalFilePath(old_file_path, new_file_path) == 0
+                && RunEvalInEnv(mockAlgo, {}, NoiseThresholds(), result) == 0
+                && MakeEvalResultRecord("mock", result, record) == 0;
+            QMetaObject::invokeMethod(this, [this, ok, record]() {
+                if(!ok)
+                {
+                    QMessageBox::warning(this, "Warning", "Failed to get evaluation result.");
+                    return;
+                }
+                result_model->AppendResult(record);
+                ui.statusbar->showMessage(QString("Evaluation finished: %1 (%2 environment warnings)")
+                    .arg(QString::fromStdString(record.algo_name))
+                    .arg(static_cast<qulonglong>(record.env_warnings.size())), 5000);
+            }, Qt::QueuedConnection);
+        });
+        connect(eval_thread, &QThread::finished, this, [this, eval_thread]() {
+            eval_threads.erase(std::remove(eval_threads.begin(), eval_threads.end(), eval_thread), eval_threads.end());
+            eval_thread->deleteLater();
+        });
+        eval_threads.push_back(eval_thread);
+        ui.statusbar->showMessage("Evaluation running...");
+        eval_thread->start();
+    }
+
+    void onPushButtonLoadResultsClicked()
+    {
+        QString filePath = QFileDialog::getOpenFileName(this, "Load Results", "", "Result files (*.json);;All files (*.*)");
+        if(filePath.isEmpty())
+        {
+            return;
+        }
+        std::vector<EvalResultRecord> records;
+        if(LoadEvalResultRecords(filePath.toStdString(), records) != 0)
         {
-            QMessageBox::warning(this, "Warning", "Failed to get evaluation result.");
+            QMessageBox::warning(this, "Warning", "Failed to load results.");
             return;
         }
-        
-        result.GetEvalResult(old_file_path, new_file_path, old_file_md5, new_file_md5, duration, memory, cpu);
-        // Display the evaluation result in a message box or any other UI element
-        QString resultMessage = QString("Algorithm: %1\nOld File: %2\nNew File: %3\nMD5: %4\nMD5: %5\nDuration: %6 seconds\nMemory: %7 bytes\nCPU: %8%")
-            .arg("MockAlgo") // Replace with the actual algorithm name
-            .arg(QString::fromStdString(old_file_path))
-            .arg(QString::fromStdString(new_file_path))
-            .arg(QString::fromStdString(old_file_md5))
-            .arg(QString::fromStdString(new_file_md5))
-            .arg(duration.count())
-            .arg(memory)
-            .arg(cpu);
-        // Show the result message in a message box
-        QMessageBox::information(this, "Evaluation Result", resultMessage);
+        result_model->AppendResults(records);
+        ui.statusbar->showMessage(QString("Loaded %1 results").arg(static_cast<qulonglong>(records.size())), 5000);
+    }
+
+    void onPushButtonClearResultsClicked()
+    {
+        result_model->Clear();
+        ui.comboBox_algofilter->clear();
+        ui.comboBox_algofilter->addItem("All");
+    }
+
+    void onResultFilterChanged()
+    {
+        EvalResultModel::Filter filter;
+        filter.algo_name = ui.comboBox_algofilter->currentIndex() > 0 ? ui.comboBox_algofilter->currentText().toStdString() : std::string();
+        filter.hash_part = ui.lineEdit_hashfilter->text().trimmed().toLower().toStdString();
+        filter.metric_column = EvalResultModel::ColumnDuration + std::max(0, ui.comboBox_metric->currentIndex());
+        filter.min = ui.lineEdit_metricmin->text().toDouble(&filter.has_min);
+        filter.max = ui.lineEdit_metricmax->text().toDouble(&filter.has_max);
+        result_model->SetFilter(filter);
+        result_chart->SetMetric(filter.metric_column);
+        ui.statusbar->showMessage(QString("%1 of %2 results match")
+            .arg(static_cast<qulonglong>(result_model->GetMatchCount()))
+            .arg(static_cast<qulonglong>(result_model->GetTotalCount())), 5000);
     }
+private:
+    void setupResultView()
+    {
+        // The model filters and sorts itself, a proxy would only see the rows fetched so far
+        result_model = new EvalResultModel(this);
+
+        ui.tableView_results->setModel(result_model);
+        ui.tableView_results->setSortingEnabled(true);
+        ui.tableView_results->setSelectionBehavior(QAbstractItemView::SelectRows);
+        ui.tableView_results->setWordWrap(false);
+        // Fixed row heights keep scrolling cheap with many rows
+        ui.tableView_results->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+        ui.tableView_results->verticalHeader()->setDefaultSectionSize(20);
+        ui.tableView_results->verticalHeader()->hide();
+        ui.tableView_results->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
+        ui.tableView_results->sortByColumn(EvalResultModel::ColumnDuration, Qt::AscendingOrder);
+
+        result_chart = new EvalResultChart(ui.widget_chart);
+        result_chart->SetModel(result_model);
+        QVBoxLayout* chart_layout = new QVBoxLayout(ui.widget_chart);
+        chart_layout->setContentsMargins(0, 0, 0, 0);
+        chart_layout->addWidget(result_chart);
+
+        ui.comboBox_algofilter->addItem("All");
+        connect(result_model, &EvalResultModel::algoAdded, this, [this](const QString& algo_name) {
+            ui.comboBox_algofilter->addItem(algo_name);
+        });
+        connect(ui.comboBox_algofilter, &QComboBox::currentIndexChanged, this, &MainWindow::onResultFilterChanged);
+        connect(ui.comboBox_metric, &QComboBox::currentIndexChanged, this, &MainWindow::onResultFilterChanged);
+        connect(ui.lineEdit_hashfilter, &QLineEdit::textChanged, this, &MainWindow::onResultFilterChanged);
+        connect(ui.lineEdit_metricmin, &QLineEdit::textChanged, this, &MainWindow::onResultFilterChanged);
+        connect(ui.lineEdit_metricmax, &QLineEdit::textChanged, this, &MainWindow::onResultFilterChanged);
+    }
+
 private:
     Ui::MainWindow ui;
     AlgoSelect algo_sel;
     FileSelect file_sel;
+    EvalResultModel* result_model = nullptr;
+    EvalResultChart* result_chart = nullptr;
+    std::vector<QThread*> eval_threads; // Running evaluations, waited for on close
 };
 
+static void registerAlgoWrappers()
+{
+    AlgoRegistry::Instance().Register("mock", []() { return std::make_unique<MockAlgo>(); });
+}
+
 int main(int argc, char *argv[])
 {
+    registerAlgoWrappers();
+    if(IsEvalCliInvocation(argc, argv))
+    {
+        return RunEvalCli(argc, argv); // Headless evaluation modes
+    }
+
     QApplication app(argc, argv);
 
     MainWindow mainWindow;
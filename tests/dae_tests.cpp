@@ -0,0 +1,452 @@
+// Unit tests of the header-only evaluation helpers, one ctest case per test name.
+// Run without arguments to run every test.
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+#ifdef DAE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "eval_stats.h"
+#include "eval_baseline.h"
+#include "input_profile.h"
+#include "preprocess.h"
+
+#define DAE_CHECK(condition)                                                   \
+    do                                                                         \
+    {                                                                          \
+        if(!(condition))                                                       \
+        {                                                                      \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            return -1; /* Test failed */                                       \
+        }                                                                      \
+    } while(0)
+
+namespace
+{
+
+int testWelchTTest()
+{
+    std::vector<double> a = {1.0, 2.0, 3.0, 4.0, 5.0};
+    std::vector<double> b = {2.0, 3.0, 4.0, 5.0, 6.0};
+    DAE_CHECK(eval_stats::WelchTTestPValue(a, a) > 0.99);
+    DAE_CHECK(std::fabs(eval_stats::WelchTTestPValue(a, b) - 0.3466) < 0.001); // t = -1 with 8 degrees of freedom
+    DAE_CHECK(std::fabs(eval_stats::WelchTTestPValue(a, b) - eval_stats::WelchTTestPValue(b, a)) < 1e-12);
+
+    std::vector<double> fast = {10.0, 10.1, 9.9, 10.05, 9.95};
+    std::vector<double> slow = {20.0, 20.1, 19.9, 20.05, 19.95};
+    DAE_CHECK(eval_stats::WelchTTestPValue(fast, slow) < 0.001);
+
+    // Degenerate inputs compare the means exactly
+    DAE_CHECK(eval_stats::WelchTTestPValue({1.0}, {2.0}) == 0.0);
+    DAE_CHECK(eval_stats::WelchTTestPValue({3.0, 3.0}, {3.0, 3.0}) == 1.0);
+    DAE_CHECK(eval_stats::WelchTTestPValue({3.0, 3.0}, {4.0, 4.0}) == 0.0);
+    return 0; // Success
+}
+
+struct TestCase
+{
+    std::string algo_name;
+    std::string new_md5;
+    std::vector<uint64_t> memory; // One sample per value
+};
+
+std::string baselineJson(const std::vector<TestCase>& cases)
+{
+    std::string json = "{\"version\": 1, \"cases\": [";
+    for(size_t index = 0; index < cases.size(); index++)
+    {
+        const TestCase& test_case = cases[index];
+        json += index == 0 ? "" : ",";
+        json += "{\"algo\": \"" + test_case.algo_name + "\", \"io_mode\": \"file\", \"old_md5\": \"old\", \"new_md5\": \""
+                + test_case.new_md5 + "\", \"samples\": [";
+        for(size_t sample = 0; sample < test_case.memory.size(); sample++)
+        {
+            json += sample == 0 ? "" : ",";
+            json += "{\"duration\": 1.0, \"memory\": " + std::to_string(test_case.memory[sample]) + ", \"patch_size\": 100}";
+        }
+        json += "]}";
+    }
+    return json + "]}";
+}
+
+int loadBaseline(const std::string& file_path, const std::vector<TestCase>& cases, EvalBaseline& baseline)
+{
+    std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+    file << baselineJson(cases);
+    file.close();
+    if(!file)
+    {
+        return -1; // Failed to write the file
+    }
+    return baseline.LoadFromFile(file_path);
+}
+
+const CaseComparison* findComparison(const std::vector<CaseComparison>& comparisons, const std::string& algo_name)
+{
+    for(const auto& comparison : comparisons)
+    {
+        if(comparison.algo_name == algo_name)
+        {
+            return &comparison;
+        }
+    }
+    return nullptr;
+}
+
+const MetricComparison* findMetric(const CaseComparison& comparison, const std::string& metric)
+{
+    for(const auto& metric_comparison : comparison.metrics)
+    {
+        if(metric_comparison.metric == metric)
+        {
+            return &metric_comparison;
+        }
+    }
+    return nullptr;
+}
+
+int testRegressionGate()
+{
+    EvalBaseline baseline, current;
+    DAE_CHECK(loadBaseline("gate_baseline.json", {{"steady", "n1", {100, 101, 99, 100}},
+                                                  {"grows", "n1", {100, 101, 99, 100}},
+                                                  {"dropped", "n1", {100, 101, 99, 100}}}, baseline) == 0);
+    DAE_CHECK(loadBaseline("gate_current.json", {{"steady", "n1", {100, 100, 101, 99}},
+                                                 {"grows", "n1", {200, 201, 199, 200}},
+                                                 {"added", "n1", {100, 101, 99, 100}}}, current) == 0);
+
+    RegressionGate gate{RegressionThresholds()};
+    std::vector<CaseComparison> comparisons;
+    DAE_CHECK(gate.Compare(baseline, current, comparisons) == 0);
+    DAE_CHECK(comparisons.size() == 4);
+
+    const CaseComparison* steady = findComparison(comparisons, "steady");
+    DAE_CHECK(steady != nullptr && steady->in_baseline && steady->in_current);
+    DAE_CHECK(findMetric(*steady, "memory") != nullptr && findMetric(*steady, "memory")->change == MetricChange::Unchanged);
+
+    const CaseComparison* grows = findComparison(comparisons, "grows");
+    DAE_CHECK(grows != nullptr && findMetric(*grows, "memory") != nullptr);
+    DAE_CHECK(findMetric(*grows, "memory")->change == MetricChange::Regressed);
+    DAE_CHECK(std::fabs(findMetric(*grows, "memory")->relative_change - 1.0) < 0.01);
+    DAE_CHECK(findMetric(*grows, "patch_size")->change == MetricChange::Unchanged);
+    DAE_CHECK(RegressionGate::HasRegression(comparisons));
+
+    const CaseComparison* added = findComparison(comparisons, "added");
+    DAE_CHECK(added != nullptr && !added->in_baseline && added->metrics.empty());
+
+    // A baseline case the current run did not produce counts as missing
+    const CaseComparison* dropped = findComparison(comparisons, "dropped");
+    DAE_CHECK(dropped != nullptr && dropped->in_baseline && !dropped->in_current && !dropped->skipped);
+    DAE_CHECK(RegressionGate::CountMissingCases(comparisons) == 1);
+
+    // unless the scheduler skipped it
+    current.AddSkipped("dropped", "file", "", "old", "n1");
+    DAE_CHECK(gate.Compare(baseline, current, comparisons) == 0);
+    dropped = findComparison(comparisons, "dropped");
+    DAE_CHECK(dropped != nullptr && dropped->skipped);
+    DAE_CHECK(RegressionGate::CountMissingCases(comparisons) == 0);
+
+    // Skipping a different pair does not excuse it
+    current.Clear();
+    DAE_CHECK(loadBaseline("gate_current.json", {{"steady", "n1", {100, 100, 101, 99}}}, current) == 0);
+    current.AddSkipped("dropped", "file", "", "old", "n2");
+    DAE_CHECK(gate.Compare(baseline, current, comparisons) == 0);
+    DAE_CHECK(RegressionGate::CountMissingCases(comparisons) == 2);
+    return 0; // Success
+}
+
+void appendLE16(std::vector<uint8_t>& data, uint16_t value)
+{
+    data.push_back(static_cast<uint8_t>(value));
+    data.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+void appendLE32(std::vector<uint8_t>& data, uint32_t value)
+{
+    appendLE16(data, static_cast<uint16_t>(value));
+    appendLE16(data, static_cast<uint16_t>(value >> 16));
+}
+
+struct ZipTestEntry
+{
+    std::string name;
+    uint16_t method = 0; // 0 stored, 8 deflated
+    std::vector<uint8_t> data; // As stored in the archive
+    uint32_t size = 0; // Declared uncompressed size
+};
+
+// Minimal archive without CRCs, which UnzipPreprocessor does not check
+std::vector<uint8_t> makeZip(const std::vector<ZipTestEntry>& entries)
+{
+    std::vector<uint8_t> archive;
+    std::vector<uint32_t> local_offsets;
+    for(const auto& entry : entries)
+    {
+        local_offsets.push_back(static_cast<uint32_t>(archive.size()));
+        appendLE32(archive, 0x04034b50);
+        appendLE16(archive, 20); // Version needed
+        appendLE16(archive, 0); // Flags
+        appendLE16(archive, entry.method);
+        appendLE32(archive, 0); // Time and date
+        appendLE32(archive, 0); // CRC-32
+        appendLE32(archive, static_cast<uint32_t>(entry.data.size()));
+        appendLE32(archive, entry.size);
+        appendLE16(archive, static_cast<uint16_t>(entry.name.size()));
+        appendLE16(archive, 0); // Extra field length
+        archive.insert(archive.end(), entry.name.begin(), entry.name.end());
+        archive.insert(archive.end(), entry.data.begin(), entry.data.end());
+    }
+    uint32_t central_offset = static_cast<uint32_t>(archive.size());
+    for(size_t index = 0; index < entries.size(); index++)
+    {
+        const ZipTestEntry& entry = entries[index];
+        appendLE32(archive, 0x02014b50);
+        appendLE16(archive, 20); // Version made by
+        appendLE16(archive, 20); // Version needed
+        appendLE16(archive, 0); // Flags
+        appendLE16(archive, entry.method);
+        appendLE32(archive, 0); // Time and date
+        appendLE32(archive, 0); // CRC-32
+        appendLE32(archive, static_cast<uint32_t>(entry.data.size()));
+        appendLE32(archive, entry.size);
+        appendLE16(archive, static_cast<uint16_t>(entry.name.size()));
+        appendLE16(archive, 0); // Extra field length
+        appendLE16(archive, 0); // Comment length
+        appendLE16(archive, 0); // Disk number
+        appendLE16(archive, 0); // Internal attributes
+        appendLE32(archive, 0); // External attributes
+        appendLE32(archive, local_offsets[index]);
+        archive.insert(archive.end(), entry.name.begin(), entry.name.end());
+    }
+    uint32_t central_size = static_cast<uint32_t>(archive.size()) - central_offset;
+    appendLE32(archive, 0x06054b50);
+    appendLE16(archive, 0); // Disk number
+    appendLE16(archive, 0); // Disk with the central directory
+    appendLE16(archive, static_cast<uint16_t>(entries.size()));
+    appendLE16(archive, static_cast<uint16_t>(entries.size()));
+    appendLE32(archive, central_size);
+    appendLE32(archive, central_offset);
+    appendLE16(archive, 0); // Comment length
+    return archive;
+}
+
+// Expected UnzipPreprocessor output of one entry
+void appendUnzipped(std::vector<uint8_t>& output, const std::string& name, const std::vector<uint8_t>& data)
+{
+    output.insert(output.end(), name.begin(), name.end());
+    output.push_back(0);
+    for(int shift = 0; shift < 64; shift += 8)
+    {
+        output.push_back(static_cast<uint8_t>(static_cast<uint64_t>(data.size()) >> shift));
+    }
+    output.insert(output.end(), data.begin(), data.end());
+}
+
+std::vector<uint8_t> bytesOf(const std::string& text)
+{
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+#ifdef DAE_HAVE_ZLIB
+// window_bits as for deflateInit2: 16 + MAX_WBITS for gzip, -MAX_WBITS for raw deflate
+std::vector<uint8_t> deflateData(const std::vector<uint8_t>& data, int window_bits)
+{
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    std::vector<uint8_t> output;
+    if(deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return output;
+    }
+    output.resize(deflateBound(&stream, static_cast<uLong>(data.size())));
+    stream.next_in = const_cast<Bytef*>(data.data());
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = output.data();
+    stream.avail_out = static_cast<uInt>(output.size());
+    int ret = deflate(&stream, Z_FINISH);
+    output.resize(ret == Z_STREAM_END ? stream.total_out : 0);
+    deflateEnd(&stream);
+    return output;
+}
+#endif
+
+std::vector<uint8_t> repeatedText(size_t size)
+{
+    std::vector<uint8_t> data;
+    const std::string line = "the quick brown fox jumps over the lazy dog\n";
+    while(data.size() < size)
+    {
+        data.insert(data.end(), line.begin(), line.end());
+    }
+    data.resize(size);
+    return data;
+}
+
+int testUnzipRoundTrip()
+{
+    UnzipPreprocessor unzip;
+    std::vector<uint8_t> output;
+
+    // Entries come out sorted by name whatever their order in the archive
+    std::vector<uint8_t> first = bytesOf("first entry"), second = bytesOf("second");
+    std::vector<uint8_t> archive = makeZip({{"b.txt", 0, second, static_cast<uint32_t>(second.size())},
+                                            {"a.txt", 0, first, static_cast<uint32_t>(first.size())}});
+    DAE_CHECK(unzip.Process(archive, output) == 0);
+    std::vector<uint8_t> expected;
+    appendUnzipped(expected, "a.txt", first);
+    appendUnzipped(expected, "b.txt", second);
+    DAE_CHECK(output == expected);
+
+    DAE_CHECK(unzip.Process(makeZip({}), output) == 0 && output.empty());
+    DAE_CHECK(unzip.Process(bytesOf("not a zip archive at all"), output) != 0);
+    archive.resize(archive.size() / 2);
+    DAE_CHECK(unzip.Process(archive, output) != 0);
+
+#ifdef DAE_HAVE_ZLIB
+    std::vector<uint8_t> text = repeatedText(100000);
+    std::vector<uint8_t> deflated = deflateData(text, -MAX_WBITS);
+    DAE_CHECK(!deflated.empty());
+    DAE_CHECK(unzip.Process(makeZip({{"text", 8, deflated, static_cast<uint32_t>(text.size())}}), output) == 0);
+    expected.clear();
+    appendUnzipped(expected, "text", text);
+    DAE_CHECK(output == expected);
+
+    // The declared size is only a hint, the stream decides
+    DAE_CHECK(unzip.Process(makeZip({{"text", 8, deflated, 0xFFFFFFF0}}), output) == 0);
+    DAE_CHECK(output == expected);
+
+    deflated.resize(deflated.size() / 2);
+    DAE_CHECK(unzip.Process(makeZip({{"text", 8, deflated, static_cast<uint32_t>(text.size())}}), output) != 0);
+#endif
+    return 0; // Success
+}
+
+int testGunzipRoundTrip()
+{
+    GunzipPreprocessor gunzip;
+    std::vector<uint8_t> output;
+#ifdef DAE_HAVE_ZLIB
+    std::vector<uint8_t> text = repeatedText(200000);
+    std::vector<uint8_t> gzipped = deflateData(text, 16 + MAX_WBITS);
+    DAE_CHECK(!gzipped.empty());
+    DAE_CHECK(gunzip.Process(gzipped, output) == 0);
+    DAE_CHECK(output == text);
+
+    // Concatenated members decompress to the concatenation of their contents
+    std::vector<uint8_t> tail = bytesOf("tail member");
+    std::vector<uint8_t> second = deflateData(tail, 16 + MAX_WBITS);
+    gzipped.insert(gzipped.end(), second.begin(), second.end());
+    DAE_CHECK(gunzip.Process(gzipped, output) == 0);
+    std::vector<uint8_t> expected = text;
+    expected.insert(expected.end(), tail.begin(), tail.end());
+    DAE_CHECK(output == expected);
+
+    gzipped.resize(gzipped.size() / 3);
+    DAE_CHECK(gunzip.Process(gzipped, output) != 0);
+#endif
+    DAE_CHECK(gunzip.Process(bytesOf("plain text"), output) != 0);
+    return 0; // Success
+}
+
+int testSchedulerPlan()
+{
+    AlgoWinHistory history;
+    std::vector<std::string> algo_names = {"a", "b", "c"};
+    AlgoSchedulePlan plan;
+
+    AlgoInputProfile profile;
+    {
+        AlgoScheduler scheduler(history, AlgoScheduleConfig());
+        DAE_CHECK(scheduler.Plan(profile, algo_names, plan) != 0); // Not analyzed
+    }
+
+    // Unrelated inputs with a compressed new file skip every algorithm
+    profile.analyzed = true;
+    profile.similarity = 0.01;
+    profile.new_kind = AlgoContentKind::Compressed;
+    {
+        AlgoScheduler scheduler(history, AlgoScheduleConfig());
+        DAE_CHECK(scheduler.Plan(profile, algo_names, plan) == 0);
+        DAE_CHECK(plan.algo_names.empty() && plan.skipped.size() == 3);
+    }
+
+    // Without enough history everything runs in the configured order
+    profile.similarity = 0.8;
+    profile.new_kind = AlgoContentKind::Binary;
+    AlgoScheduleConfig config;
+    config.keep_top = 1;
+    config.min_history = 3;
+    config.explore_every = 3;
+    AlgoScheduler scheduler(history, config);
+    DAE_CHECK(scheduler.Plan(profile, algo_names, plan) == 0);
+    DAE_CHECK(plan.algo_names == algo_names && plan.skipped.empty() && plan.full_run && !plan.exploring);
+
+    // With it only the most frequent winner runs
+    std::string profile_key = InputProfiler::GetProfileKey(profile);
+    history.RecordWin(profile_key, "c");
+    history.RecordWin(profile_key, "c");
+    history.RecordWin(profile_key, "b");
+    DAE_CHECK(scheduler.Plan(profile, algo_names, plan) == 0);
+    DAE_CHECK(plan.algo_names == std::vector<std::string>({"c"}));
+    DAE_CHECK(plan.skipped.size() == 2 && plan.skipped[0].first == "b" && plan.skipped[1].first == "a");
+    DAE_CHECK(!plan.full_run && !plan.exploring);
+
+    // Every third pair of the profile explores, runs everything and puts the winners first
+    DAE_CHECK(scheduler.Plan(profile, algo_names, plan) == 0);
+    DAE_CHECK(plan.algo_names == std::vector<std::string>({"c", "b", "a"}));
+    DAE_CHECK(plan.skipped.empty() && plan.full_run && plan.exploring);
+
+    // Other profiles keep their own history
+    profile.new_kind = AlgoContentKind::Text;
+    DAE_CHECK(scheduler.Plan(profile, algo_names, plan) == 0);
+    DAE_CHECK(plan.algo_names == algo_names && plan.full_run);
+    return 0; // Success
+}
+
+struct NamedTest
+{
+    const char* name;
+    int (*run)();
+};
+
+const NamedTest tests[] = {
+    {"welch_t_test", testWelchTTest},
+    {"regression_gate", testRegressionGate},
+    {"unzip_round_trip", testUnzipRoundTrip},
+    {"gunzip_round_trip", testGunzipRoundTrip},
+    {"scheduler_plan", testSchedulerPlan},
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int failed = 0;
+    int matched = 0;
+    for(const auto& test : tests)
+    {
+        if(argc > 1 && std::strcmp(argv[1], test.name) != 0)
+        {
+            continue;
+        }
+        matched++;
+        if(test.run() != 0)
+        {
+            std::fprintf(stderr, "FAILED %s\n", test.name);
+            failed++;
+        }
+    }
+    if(matched == 0)
+    {
+        std::fprintf(stderr, "Unknown test %s\n", argv[1]);
+        return 1;
+    }
+    return failed == 0 ? 0 : 1;
+}